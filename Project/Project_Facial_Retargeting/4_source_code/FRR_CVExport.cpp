@@ -1,6 +1,9 @@
 //FRRCVExport -cln "kokoCtrlList.dat" -cfn "kokoROE.dat" -f 36
+//FRRCVExport -cln "kokoCtrlList.dat" -cfn "kokoROE.frm" -f 36
 
 #include "FRR_CVExport.h"
+#include "FRR_matrixFile.h"
+#include "FRR_retarget.h"
 #include <maya/MPlug.h>
 
 const char *ctrlFileNameFlag = "-cln", *ctrlFileNameLongFlag = "-ctrlListFileName";
@@ -29,9 +32,6 @@ MStatus FRRCVEXPORTCmd::doIt(const MArgList &args)
 	if (argData.isFlagSet(frameNumFlag))
 		argData.getFlagArgument(frameNumFlag, 0, frameNum);
 
-	//open controller list file
-	ifstream fin;
-	fin.open(ctrlFileName.asChar());
 
 	//---------------------------------------------------------------TODO---------------------------------------------------------------//
 	//	Write your code here! (5~20 lines)																								//
@@ -40,15 +40,12 @@ MStatus FRRCVEXPORTCmd::doIt(const MArgList &args)
 
 	// Make the controller list and get each controller from the target controller list file
 	MStringArray ctrlListArr;
-	while (!fin.eof()) {
-		char temp[100];
-		fin >> temp;
-		ctrlListArr.append(temp);
+	MStatus stat = FRRRETARGETCmd::readCtrlList(ctrlFileName, ctrlListArr);
+	if (!stat) {
+		stat.perror("Cannot read the controller list " + ctrlFileName);
+		return stat;
 	}
 
-	//close controller list file
-	fin.close(); 
-	
 
 	//---------------------------------------------------------------TODO---------------------------------------------------------------//
 	//	Write your code here! (20~40 lines)																								//
@@ -71,51 +68,23 @@ MStatus FRRCVEXPORTCmd::doIt(const MArgList &args)
 	//	HINT Functions:  MGlobal::selectByName(your controller), MFnTransform.findPlug(attributes..)
 	//----------------------------------------------------------------------------------------------------------------------------------//
 
-	//open the export file
-	ofstream fout;
-	fout.open(CVExportFileName.asChar());
-			
-	// Iterate the controllers at each frame
-	for (int i = 1; i <= frameNum; i++) {
-		// View the next frame
-		MGlobal::viewFrame(i);
-
-		for (int j = 0; j < ctrlListArr.length(); j++) {
-			// Select a blendshape node by name
-			MGlobal::selectByName(ctrlListArr[j], MGlobal::kReplaceList);
-			MSelectionList selected;
-			MGlobal::getSelectionListByName(ctrlListArr[j], selected);
-
-			// Make the object for getting transform attributes
-			MObject ctrlNode;
-			selected.getDependNode(0, ctrlNode);
-			
-			MFnTransform ctrlTransform(ctrlNode);
-
-			// Get plugs to access the keyable attribute values of controllers
-			// - Attributes list: "translateX","translateY","translateZ","rotateX","rotateY","rotateZ"
-			MPlug trXPlug = ctrlTransform.findPlug("translateX");
-			MPlug trYPlug = ctrlTransform.findPlug("translateY");
-			MPlug trZPlug = ctrlTransform.findPlug("translateZ");
-			MPlug rtXPlug = ctrlTransform.findPlug("rotateX");
-			MPlug rtYPlug = ctrlTransform.findPlug("rotateY");
-			MPlug rtZPlug = ctrlTransform.findPlug("rotateZ");
-
-			// Write down the attribute values on the file
-			// - Since all joints do not have all attributes (because of DoF), check that the plug is connected
-			if (trXPlug.isConnected())	fout << trXPlug.asDouble() << " ";
-			if (trYPlug.isConnected())	fout << trYPlug.asDouble() << " ";
-			if (trZPlug.isConnected())	fout << trZPlug.asDouble() << " ";
-			if (rtXPlug.isConnected())	fout << rtXPlug.asDouble() << " ";
-			if (rtYPlug.isConnected())	fout << rtYPlug.asDouble() << " ";
-			if (rtZPlug.isConnected())	fout << rtZPlug.asDouble() << " ";
-		}
-		fout << endl;
+	// Get plugs to access the keyable attribute values of controllers (once, not at each frame)
+	// - Attributes list: "translateX","translateY","translateZ","rotateX","rotateY","rotateZ"
+	// - Since all joints do not have all attributes (because of DoF), only the connected plugs are used
+	std::vector<MPlug> ctrlPlugs;
+	std::vector<std::string> names;
+	stat = FRRRETARGETCmd::findCtrlPlugs(ctrlListArr, ctrlPlugs, &names);
+	if (!stat) {
+		stat.perror("Cannot find the controllers of " + ctrlFileName);
+		return stat;
 	}
-	
 
-	//close the export file
-	fout.close();
+	// Evaluate the plugs at frames 1 ~ frameNum (row major), without changing the current frame or the selection
+	std::vector<double> values;
+	if (frameNum > 0) FRRRETARGETCmd::samplePlugs(ctrlPlugs, 1, frameNum, values);
+
+	// Write down the attribute values on the file (.dat, or binary matrix file for .frm)
+	FRRMatrixFile::save(CVExportFileName.asChar(), values.empty() ? NULL : &values[0], frameNum, (int)ctrlPlugs.size(), names);
 	
 	return redoIt();
 }
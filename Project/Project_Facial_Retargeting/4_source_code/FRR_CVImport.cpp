@@ -1,13 +1,18 @@
 //FRRCVImport -cln "kokoCtrlList.dat" -ffn "kokoFinalResult.dat"
+//FRRCVImport -cln "kokoCtrlList.dat" -ffn "kokoFinalResult.dat" -tol 0.01
 
 #include "FRR_CVImport.h"
+#include "FRR_Training.h"
+#include "FRR_retarget.h"
+#include "FRR_dataCache.h"
 #include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
 #include <maya/MFnAnimCurve.h>
 #include <maya/MTime.h>
-#include <sstream>
 
 const char *importCharCtrlListFlag = "-cln", *importCharCtrlListLongFlag = "-ctrlListFileName";
 const char *importFileNameFlag = "-ffn", *importFileNameLongFlag = "-finalFileName";
+const char *importToleranceFlag = "-tol", *importToleranceLongFlag = "-tolerance";
 
 
 
@@ -16,6 +21,7 @@ MSyntax FRRCVIMPORTCmd::newSyntax()
 	MSyntax syntax;
 	syntax.addFlag(importCharCtrlListFlag, importCharCtrlListLongFlag, MSyntax::kString);
 	syntax.addFlag(importFileNameFlag, importFileNameLongFlag, MSyntax::kString);
+	syntax.addFlag(importToleranceFlag, importToleranceLongFlag, MSyntax::kDouble);
 	return syntax;
 }
 
@@ -30,9 +36,13 @@ MStatus FRRCVIMPORTCmd::doIt(const MArgList &args)
 	if (argData.isFlagSet(importFileNameFlag))
 		argData.getFlagArgument(importFileNameFlag, 0, CVImportFileName);
 
-	//open controller list file
-	ifstream fin;
-	fin.open(ctrlListFileName.asChar());
+	// Fit each channel with a reduced set of keys instead of keying every frame
+	if (argData.isFlagSet(importToleranceFlag))
+	{
+		double tolerance = 0.0;
+		argData.getFlagArgument(importToleranceFlag, 0, tolerance);
+		return importReduced(ctrlListFileName, CVImportFileName, tolerance);
+	}
 
 	//---------------------------------------------------------------TODO---------------------------------------------------------------//
 	//	Write your code here! (5~20 lines)																								//
@@ -41,15 +51,14 @@ MStatus FRRCVIMPORTCmd::doIt(const MArgList &args)
 
 	// Make the controller list and get each controller from the target controller list file
 	MStringArray ctrlListArr;
-	while (!fin.eof()) {
-		char temp[100];
-		fin >> temp;
-		ctrlListArr.append(temp);
+	std::vector<MPlug> ctrlPlugs;
+	MStatus stat = FRRRETARGETCmd::readCtrlList(ctrlListFileName, ctrlListArr);
+	if (stat) stat = FRRRETARGETCmd::findCtrlPlugs(ctrlListArr, ctrlPlugs);
+	if (!stat) {
+		stat.perror("Cannot find the controllers of " + ctrlListFileName);
+		return stat;
 	}
 
-	//close controller list file
-	fin.close(); 
-
 
 	//---------------------------------------------------------------TODO---------------------------------------------------------------//
 	//	Write your code here! (20~45 lines)																								//
@@ -67,27 +76,21 @@ MStatus FRRCVIMPORTCmd::doIt(const MArgList &args)
 	//	4. Lastly, set keyframes!																										//
 	//----------------------------------------------------------------------------------------------------------------------------------//
 
-	//open the final result file
-	fin.open(CVImportFileName.asChar());
-
-	// Make variables for final result
-	MStringArray finalResultArr;
-	std::string temp;
-	int frameCount = 1;
+	// Read the final result (.dat, .frm, .fra or a dataset of a bundle), one row per frame
+	FRRDataCache::Matrix finalResult = FRRDataCache::matrix(CVImportFileName.asChar());
+	if (!finalResult || finalResult->numRows() == 0 || finalResult->numCols != (int)ctrlPlugs.size()) {
+		stat = MS::kFailure;
+		stat.perror("The final result does not match the controller list!");
+		return stat;
+	}
 
-	// Read each line of control vector list file and split the values
-	while (std::getline(fin, temp)) {
+	// Set the values of each frame
+	for (int frame = 0; frame < finalResult->numRows(); frame++) {
+		int frameCount = frame + 1;
 		MGlobal::viewFrame(frameCount);
+		const double* finalResultRow = finalResult->row(frame);
 		int tempNum = 0;
 
-		// Split the values in final result file
-		std::istringstream iss(temp);
-		while (iss) {
-			std::string tmp;
-			iss >> tmp;
-			finalResultArr.append(tmp.c_str());
-		}
-
 		// Iterate controllers at each frame
 		for (int j = 0; j < ctrlListArr.length(); j++) {
 			// Select a blendshape node by name
@@ -116,37 +119,31 @@ MStatus FRRCVIMPORTCmd::doIt(const MArgList &args)
 			// Set the keyable attribute values of controllers
 			// - Since all joints do not have all attributes (because of DoF), check that the plug is connected
 			if (trXPlug.isConnected()) {
-				trXPlug.setDouble(finalResultArr[tempNum++].asDouble());
+				trXPlug.setDouble(finalResultRow[tempNum++]);
 				MGlobal::executeCommand(MString("setKeyframe " + ctrlListArr[j] +".translateX"));
 			}
 			if (trYPlug.isConnected()) {
-				trYPlug.setDouble(finalResultArr[tempNum++].asDouble());
+				trYPlug.setDouble(finalResultRow[tempNum++]);
 				MGlobal::executeCommand(MString("setKeyframe " + ctrlListArr[j] + ".translateY"));
 			}
 			if (trZPlug.isConnected()) {
-				trZPlug.setDouble(finalResultArr[tempNum++].asDouble());
+				trZPlug.setDouble(finalResultRow[tempNum++]);
 				MGlobal::executeCommand(MString("setKeyframe " + ctrlListArr[j] + ".translateZ"));
 			}
 			if (rtXPlug.isConnected()) {
-				rtXPlug.setDouble(finalResultArr[tempNum++].asDouble());
+				rtXPlug.setDouble(finalResultRow[tempNum++]);
 				MGlobal::executeCommand(MString("setKeyframe " + ctrlListArr[j] + ".rotateX"));
 			}
 			if (rtYPlug.isConnected()) {
-				rtYPlug.setDouble(finalResultArr[tempNum++].asDouble());
+				rtYPlug.setDouble(finalResultRow[tempNum++]);
 				MGlobal::executeCommand(MString("setKeyframe " + ctrlListArr[j] + ".rotateY"));
 ;			}
 			if (rtZPlug.isConnected()) {
-				rtZPlug.setDouble(finalResultArr[tempNum++].asDouble());
+				rtZPlug.setDouble(finalResultRow[tempNum++]);
 				MGlobal::executeCommand(MString("setKeyframe " + ctrlListArr[j] + ".rotateZ"));
 			}
 		}
-		// Free finalResultArr
-		finalResultArr.clear();
-		frameCount++;	// set the next frame number
 	}
-	
-	//close the final result file
-	fin.close();
 
 
 	return redoIt();
@@ -154,10 +151,194 @@ MStatus FRRCVIMPORTCmd::doIt(const MArgList &args)
 
 MStatus FRRCVIMPORTCmd::undoIt()
 {
+	animChange.undoIt();
 	return dgMod.undoIt();
 }
 
 MStatus FRRCVIMPORTCmd::redoIt()
 {
-	return dgMod.doIt();
+	MStatus stat = dgMod.doIt();
+	animChange.redoIt();
+	return stat;
+}
+
+
+
+// This function imports the final result with the keys reduced to tolerance (max absolute error).
+// The channels are fitted in parallel, then their keys replace the keys of frames 1 ~ numFrames
+// (on a new anim curve for the channels which were not keyed yet).
+MStatus FRRCVIMPORTCmd::importReduced(const MString& ctrlListFileName, const MString& CVImportFileName, double tolerance)
+{
+	MStatus stat;
+
+	MStringArray ctrlListArr;
+	std::vector<MPlug> ctrlPlugs;
+	stat = FRRRETARGETCmd::readCtrlList(ctrlListFileName, ctrlListArr);
+	if (stat) stat = FRRRETARGETCmd::findCtrlPlugs(ctrlListArr, ctrlPlugs);
+	if (!stat) {
+		stat.perror("Cannot find the controllers of " + ctrlListFileName);
+		return stat;
+	}
+
+	MString fileName(CVImportFileName);
+	std::vector<std::vector<double>> finalResult = FRRTRAININGCmd::importData(fileName);
+	int numFrames = finalResult.size();
+	int numChannels = ctrlPlugs.size();
+	if (numFrames == 0 || (int)finalResult[0].size() != numChannels) {
+		stat = MS::kFailure;
+		stat.perror("The final result does not match the controller list!");
+		return stat;
+	}
+
+	// Frames x channels, row-major
+	std::vector<double> values(numFrames * numChannels);
+	for (int i = 0; i < numFrames; i++)
+		std::copy(finalResult[i].begin(), finalResult[i].end(), values.begin() + i * numChannels);
+	finalResult.clear();
+
+	// Fit the channels independently on all cores
+	std::vector<std::vector<int>> keys(numChannels);
+	std::vector<std::vector<double>> slopes(numChannels);
+#pragma omp parallel for schedule(dynamic)
+	for (int j = 0; j < numChannels; j++)
+	{
+		reduceKeys(&values[j], numChannels, numFrames, tolerance, keys[j], slopes[j]);
+	}
+
+	// Find the anim curve of each channel. A channel which is not keyed yet gets a new curve
+	// (through dgMod, for undo), a channel driven by another kind of node is skipped.
+	std::vector<MObject> curves(numChannels);
+	int numSkipped = 0;
+	for (int j = 0; j < numChannels; j++)
+	{
+		MFnAnimCurve curve(ctrlPlugs[j], &stat);
+		if (stat) {
+			curves[j] = curve.object();
+			continue;
+		}
+		MPlugArray sources;
+		if (ctrlPlugs[j].connectedTo(sources, true, false) && sources.length() > 0) {
+			numSkipped++;
+			continue;
+		}
+		curves[j] = curve.create(ctrlPlugs[j], &dgMod, &stat);
+		if (!stat) {
+			stat.perror("Cannot create an anim curve for " + ctrlPlugs[j].name());
+			return stat;
+		}
+	}
+
+	// Connect the new curves before keying them
+	stat = dgMod.doIt();
+	if (!stat) {
+		stat.perror("Cannot connect the new anim curves");
+		return stat;
+	}
+
+	// Set the keys (Maya calls stay on this thread)
+	int numKeys = 0;
+	for (int j = 0; j < numChannels; j++)
+	{
+		if (curves[j].isNull()) continue;
+		MFnAnimCurve curve(curves[j]);
+
+		// Remove the old keys of the imported range
+		MTime firstTime(1.0, MTime::uiUnit()), lastTime((double)numFrames, MTime::uiUnit());
+		for (int k = (int)curve.numKeys() - 1; k >= 0; k--)
+		{
+			MTime keyTime = curve.time(k);
+			if (keyTime >= firstTime && keyTime <= lastTime) curve.remove(k, &animChange);
+		}
+
+		// Tangents are given in seconds and internal units (radians for the rotations)
+		double frameSeconds = MTime(1.0, MTime::uiUnit()).as(MTime::kSeconds);
+		for (unsigned int k = 0; k < keys[j].size(); k++)
+		{
+			int frame = keys[j][k];
+			MTime frameTime((double)(frame + 1), MTime::uiUnit());
+			unsigned int keyIndex = curve.addKey(frameTime, values[frame * numChannels + j],
+				MFnAnimCurve::kTangentFixed, MFnAnimCurve::kTangentFixed, &animChange);
+			curve.setTangent(keyIndex, frameSeconds, slopes[j][k], true, &animChange, false);
+			curve.setTangent(keyIndex, frameSeconds, slopes[j][k], false, &animChange, false);
+		}
+		numKeys += keys[j].size();
+	}
+
+	MString info("FRRCVImport: ");
+	info += numKeys;
+	info += " keys instead of ";
+	info += numFrames * (numChannels - numSkipped);
+	info += " (";
+	info += (numFrames * (numChannels - numSkipped) > 0) ? 100.0 * numKeys / (numFrames * (numChannels - numSkipped)) : 0.0;
+	info += "%)";
+	MGlobal::displayInfo(info);
+	if (numSkipped > 0)
+	{
+		MString warning("FRRCVImport: ");
+		warning += numSkipped;
+		warning += " attributes are driven by another node than an anim curve and were not keyed";
+		MGlobal::displayWarning(warning);
+	}
+
+	return MS::kSuccess;
+}
+
+// Value at frame t of the cubic Hermite segment between the keys a and b (slopes in value per frame)
+static double hermiteValue(const double* values, int stride, int a, double ma, int b, double mb, int t)
+{
+	double len = b - a;
+	double s = (t - a) / len;
+	double s2 = s * s, s3 = s2 * s;
+	return (2 * s3 - 3 * s2 + 1) * values[a * stride] + (s3 - 2 * s2 + s) * len * ma
+		+ (-2 * s3 + 3 * s2) * values[b * stride] + (s3 - s2) * len * mb;
+}
+
+// Slope of the samples at frame i (central difference, one-sided at the ends)
+static double sampleSlope(const double* values, int stride, int numFrames, int i)
+{
+	if (numFrames == 1) return 0.0;
+	if (i == 0) return values[stride] - values[0];
+	if (i == numFrames - 1) return values[i * stride] - values[(i - 1) * stride];
+	return (values[(i + 1) * stride] - values[(i - 1) * stride]) * 0.5;
+}
+
+// This function reduces one channel (values[i * stride], i = 0 ~ numFrames-1) to keys with fixed tangents.
+// The tangents are the slopes of the samples at the keys. Each key interval is grown greedily while the
+// Hermite segment stays within tolerance of every sample it covers, up to FRR_KEY_MAX_SPAN frames,
+// so the fit costs O(numFrames * FRR_KEY_MAX_SPAN).
+// Returns the number of keys (frames in keys, slopes in slopes).
+int FRRCVIMPORTCmd::reduceKeys(const double* values, int stride, int numFrames, double tolerance, std::vector<int>& keys, std::vector<double>& slopes)
+{
+	keys.clear();
+	slopes.clear();
+	if (numFrames <= 0) return 0;
+
+	int a = 0;
+	double ma = sampleSlope(values, stride, numFrames, 0);
+	keys.push_back(0);
+	slopes.push_back(ma);
+
+	while (a < numFrames - 1)
+	{
+		int last = (a + FRR_KEY_MAX_SPAN < numFrames - 1) ? a + FRR_KEY_MAX_SPAN : numFrames - 1;
+		int b = a + 1;
+		double mb = sampleSlope(values, stride, numFrames, b);
+		for (int c = a + 2; c <= last; c++)
+		{
+			double mc = sampleSlope(values, stride, numFrames, c);
+			bool fits = true;
+			for (int t = a + 1; t < c && fits; t++)
+			{
+				if (std::fabs(hermiteValue(values, stride, a, ma, c, mc, t) - values[t * stride]) > tolerance) fits = false;
+			}
+			if (!fits) break;
+			b = c;
+			mb = mc;
+		}
+		keys.push_back(b);
+		slopes.push_back(mb);
+		a = b;
+		ma = mb;
+	}
+	return keys.size();
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "global.h"
 #include <iostream>
+#include <maya/MAnimCurveChange.h>
+
+#define FRR_KEY_MAX_SPAN	64		// longest key interval (in frames) tried by the key reduction
 
 class FRRCVIMPORTCmd : public MPxCommand
 {
@@ -15,8 +18,13 @@ public:
 	static void *creator() { return new FRRCVIMPORTCmd; }
 	static MSyntax newSyntax();
 
+	static int reduceKeys(const double* values, int stride, int numFrames, double tolerance, std::vector<int>& keys, std::vector<double>& slopes);
+
 private:
+	MStatus importReduced(const MString& ctrlListFileName, const MString& CVImportFileName, double tolerance);
+
 	MDGModifier dgMod;
+	MAnimCurveChange animChange;	// keys set by -tolerance (for undo)
 };
 
 #endif
\ No newline at end of file
@@ -1,11 +1,36 @@
 //FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat"
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -mc 20 -tol 0.01
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -lm
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -at 0.01
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -cd "frrCache"
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -async
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -pr 0.01
+//FRRTraining -bfn "humanROE.frm" -cfn "kokoROE.frm" -sfn "humanSourceAnimation.frm" -ffn "kokoFinalResult.frm"
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.fra"
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -pl
+//FRRTraining -bfn "koko.frb:humanROE" -cfn "koko.frb:kokoROE" -sfn "koko.frb:humanSourceAnimation" -ffn "kokoFinalResult.dat" -sm "koko.frb:kokoModel"
+//FRRTraining -sfn "koko.frb:humanSourceAnimation" -ffn "kokoFinalResult.dat" -um "koko.frb:kokoModel"
 
 #include "FRR_Training.h"
+#include "FRR_trainingJob.h"
+#include "FRR_datFile.h"
+#include "FRR_matrixFile.h"
+#include "FRR_animFile.h"
 
 const char *blendFileFlag = "-bfn", *blendFileLongFlag = "-blendFileName";
 const char *cvFileFlag = "-cfn", *cvFileLongFlag = "-cvFileName";
 const char *sourceFileFlag = "-sfn", *sourceFileLongFlag = "-sourceFileName";
 const char *finalFileFlag = "-ffn", *finalFileLongFlag = "-finalFileName";
+const char *maxCentersFlag = "-mc", *maxCentersLongFlag = "-maxCenters";
+const char *toleranceFlag = "-tol", *toleranceLongFlag = "-tolerance";
+const char *lowMemoryFlag = "-lm", *lowMemoryLongFlag = "-lowMemory";
+const char *adaptiveFlag = "-at", *adaptiveLongFlag = "-adaptiveTolerance";
+const char *cacheDirFlag = "-cd", *cacheDirLongFlag = "-cacheDir";
+const char *asyncFlag = "-as", *asyncLongFlag = "-async";
+const char *pruneFlag = "-pr", *pruneLongFlag = "-prune";
+const char *pipelineFlag = "-pl", *pipelineLongFlag = "-pipeline";
+const char *saveModelFlag = "-sm", *saveModelLongFlag = "-saveModel";
+const char *useModelFlag = "-um", *useModelLongFlag = "-useModel";
 
 MSyntax FRRTRAININGCmd::newSyntax()
 {
@@ -14,131 +39,75 @@ MSyntax FRRTRAININGCmd::newSyntax()
 	syntax.addFlag( cvFileFlag, cvFileLongFlag, MSyntax::kString);
 	syntax.addFlag( sourceFileFlag, sourceFileLongFlag, MSyntax::kString);
 	syntax.addFlag( finalFileFlag, finalFileLongFlag, MSyntax::kString);
+	syntax.addFlag( maxCentersFlag, maxCentersLongFlag, MSyntax::kLong);
+	syntax.addFlag( toleranceFlag, toleranceLongFlag, MSyntax::kDouble);
+	syntax.addFlag( lowMemoryFlag, lowMemoryLongFlag);
+	syntax.addFlag( adaptiveFlag, adaptiveLongFlag, MSyntax::kDouble);
+	syntax.addFlag( cacheDirFlag, cacheDirLongFlag, MSyntax::kString);
+	syntax.addFlag( asyncFlag, asyncLongFlag);
+	syntax.addFlag( pruneFlag, pruneLongFlag, MSyntax::kDouble);
+	syntax.addFlag( pipelineFlag, pipelineLongFlag);
+	syntax.addFlag( saveModelFlag, saveModelLongFlag, MSyntax::kString);
+	syntax.addFlag( useModelFlag, useModelLongFlag, MSyntax::kString);
 	return syntax;
 }
 
 MStatus FRRTRAININGCmd::doIt ( const MArgList &args )
 { 
-	MString blendFile;
-	MString CVFile;
-	MString sourceFile;
-	MString finalFile;
+	FRRTrainingJob* job = new FRRTrainingJob();
 
 	MArgDatabase argData(syntax(), args);
 	if(argData.isFlagSet(blendFileFlag))
-		argData.getFlagArgument(blendFileFlag, 0, blendFile);
+		argData.getFlagArgument(blendFileFlag, 0, job->blendFile);
 	if(argData.isFlagSet(cvFileFlag))
-		argData.getFlagArgument(cvFileFlag, 0, CVFile);
+		argData.getFlagArgument(cvFileFlag, 0, job->cvFile);
 	if(argData.isFlagSet(sourceFileFlag))
-		argData.getFlagArgument(sourceFileFlag, 0, sourceFile);
+		argData.getFlagArgument(sourceFileFlag, 0, job->sourceFile);
 	if(argData.isFlagSet(finalFileFlag))
-		argData.getFlagArgument(finalFileFlag, 0, finalFile);
-
-	unsigned int humanFaceDim;
-	unsigned int cartoonFaceDim;
-	unsigned int numDataPair;
-	unsigned int numSamplePair;	//numSamplePair -> the frame number of a new input animation
-	const char* exportFile = finalFile.asChar();
-
-
-	//Initialize the object of RBF class
-	//Set basis function as hardy multiquadric function
-	rbf rbfn;
-	rbfn.setBasisFunc( rbf::BF_HARDY );
-	rbfn.setLamda(0.1);
-
-
-	//Import training sample data matrix from input files
-	std::vector<std::vector<double>> humanFaceVec = importData(blendFile);
-	std::vector<std::vector<double>> cartoonFaceVec = importData(CVFile);
-
-
-	//Initialize the dimension of the source&target data and the number of data pair
-	humanFaceDim = humanFaceVec[0].size();
-	cartoonFaceDim = cartoonFaceVec[0].size();
-	if (humanFaceVec.size() != cartoonFaceVec.size()) {
-		MStatus stat;
-		stat.perror("Data Pair Size is different!");
-		return stat;
+		argData.getFlagArgument(finalFileFlag, 0, job->finalFile);
+	if (argData.isFlagSet(maxCentersFlag)) {
+		argData.getFlagArgument(maxCentersFlag, 0, job->maxCenters);
+		job->greedy = true;
 	}
-	numDataPair = humanFaceVec.size();
-
-
-	//Reshape training sample data matrix (for using BOOST)
-	//humanFaceVec -> input
-	//cartoonFaceVec -> output
-	vector<vector<double>> input;
-	vector<vector<double>> output;
-	input.resize(numDataPair);
-	output.resize(numDataPair);
-
-	for(unsigned int i=0 ; i<numDataPair ; i++)
-	{
-		vector<double> tempVec;
-		tempVec.resize(humanFaceDim);
-		for(unsigned int j=0 ; j<humanFaceDim ; j++)
-		{
-			tempVec(j) = humanFaceVec[i][j];
-		}
-
-		input(i) = tempVec;
-		tempVec.clear();
-		tempVec.resize(cartoonFaceDim);
-		for(unsigned int k=0 ; k<cartoonFaceDim ; k++)
-		{
-			tempVec(k) = cartoonFaceVec[i][k];
-		}		
-		output(i) = tempVec;
-		tempVec.clear();
-	}	
-
-	//free
-	humanFaceVec.clear();
-	cartoonFaceVec.clear();
-
-
-	//Train RBF network from the source and target ROE data
-	rbfn.Train(input, output);
-
-	//Import source animation data matrix from file
-	std::vector<std::vector<double>> WVec = importData(sourceFile);
-
-	numSamplePair = WVec.size();
-	vector<vector<double>> result(numSamplePair);
-
-	//---------------------------------------------------------------TODO---------------------------------------------------------------//
-	//	write your code here! (10~15 lines)
-	//	Run RBF interpolation by using .interpolate(sourceInput, interpolateResult) function of rbf class
-	//----------------------------------------------------------------------------------------------------------------------------------//
-
-	// Reshape source animation data matrix (for using BOOST)
-	// WVec -> srcInput
-	vector<vector<double>> srcInput(numSamplePair);
-
-	for (unsigned int i = 0; i < numSamplePair; i++)
+	if (argData.isFlagSet(toleranceFlag)) {
+		argData.getFlagArgument(toleranceFlag, 0, job->tolerance);
+		job->greedy = true;
+	}
+	if (argData.isFlagSet(adaptiveFlag))
+		argData.getFlagArgument(adaptiveFlag, 0, job->adaptiveTolerance);
+	if (argData.isFlagSet(cacheDirFlag))
+		argData.getFlagArgument(cacheDirFlag, 0, job->cacheDir);
+	if (argData.isFlagSet(pruneFlag))
+		argData.getFlagArgument(pruneFlag, 0, job->pruneThreshold);
+	if (argData.isFlagSet(saveModelFlag))
+		argData.getFlagArgument(saveModelFlag, 0, job->saveModel);
+	if (argData.isFlagSet(useModelFlag))
+		argData.getFlagArgument(useModelFlag, 0, job->useModel);
+	job->lowMemory = argData.isFlagSet(lowMemoryFlag);
+	job->pipeline = argData.isFlagSet(pipelineFlag);
+
+	if (argData.isFlagSet(asyncFlag))
 	{
-		vector<double> tempVec;
-		tempVec.resize(humanFaceDim);
-		for (unsigned int j = 0; j < humanFaceDim; j++)
-		{
-			tempVec(j) = WVec[i][j];
+		// Run on a worker thread, query it with FRRTrainingJob -status / -progress
+		if (FRRTrainingJob::background != NULL && FRRTrainingJob::background->state() == FRRTrainingJob::kRunning) {
+			delete job;
+			MStatus stat(MStatus::kFailure);
+			stat.perror("A training job is already running!");
+			return stat;
 		}
-
-		srcInput(i) = tempVec;
-
-		// Free tempVec
-		tempVec.clear();
+		delete FRRTrainingJob::background;
+		FRRTrainingJob::background = job;
+		job->start();
+		setResult(MString("running"));
+		return redoIt();
 	}
 
-	// Free WVec
-	WVec.clear();
+	FRRTrainingJob::State state = job->run();
+	job->showMessages();
+	delete job;
+	if (state != FRRTrainingJob::kDone)
+		return MStatus::kFailure;
 
-	// Run RBF interpolation
-	rbfn.Interpolate(srcInput, result);
-
-	//export the final result matrix to file
-	exportData(result, finalFile);
-	
 	return redoIt();
 }
 
@@ -170,50 +139,54 @@ void FRRTRAININGCmd::split(std::string& text, std::string& separators, std::list
 	}
 }
 
+// This function reads the rows of numbers of a .dat file (see FRRDatFile), parsed once per
+// version of the file by the data cache
 std::vector<std::vector<double>> FRRTRAININGCmd::importData(MString& fileName)
 {
 	std::vector<std::vector<double>> result;
-	std::ifstream fin;
-	fin.open(fileName.asChar());
-	std::string inputLine;
-	std::string empty = " ";
-	while (!fin.eof())
+	FRRDataCache::Matrix dat = FRRDataCache::matrix(fileName.asChar());
+	if (!dat) return result;
+
+	int numRows = dat->numRows();
+	result.resize(numRows);
+	for (int i = 0; i < numRows; i++)
 	{
-		std::list<std::string> inputLineList;
-		std::vector<double> temp;
-		getline(fin, inputLine);
-		split(inputLine, empty, inputLineList);
-		while (!inputLineList.empty())
-		{
-			std::istringstream stm;
-			stm.str(inputLineList.front());
-			double d;
-			stm >> d;
-			temp.push_back(d);
-			inputLineList.pop_front();
-		}
-		if (temp.size() > 0) { result.push_back(temp); }
+		result[i].assign(dat->row(i), dat->row(i) + dat->rowSize(i));
 	}
-
-	fin.close();
-	fin.clear();
 	return result;
 }
 
-void FRRTRAININGCmd::exportData(vector<vector<double>> result, MString& fileName)
+// This function returns the parsed rows of a data file and sets view to them. The rows are used
+// in place in the data cache entry, which keeps them alive while it is held.
+// NULL if the file cannot be read or its rows have different lengths.
+FRRDataCache::Matrix FRRTRAININGCmd::importMatrix(const MString& fileName, rbfMatrixView& view)
 {
-	std::ofstream fout;
-	fout.open(fileName.asChar());
-	unsigned int numDimPair = result.size();
-	for (unsigned int i = 0; i<numDimPair; i++)
+	FRRDataCache::Matrix dat = FRRDataCache::matrix(fileName.asChar());
+	if (!dat || dat->numCols < 0) return FRRDataCache::Matrix();
+
+	view = rbfMatrixView(dat->values.empty() ? NULL : &dat->values[0], dat->numRows(), dat->numCols);
+	return dat;
+}
+
+// This function writes the result (numRows x numCols, row major) as a .dat file, or as a binary
+// matrix file (.frm) with the column names, straight from the buffer
+void FRRTRAININGCmd::exportData(const double* result, int numRows, int numCols, MString& fileName, const std::vector<std::string>& names)
+{
+	if (!FRRMatrixFile::isMatrixFileName(fileName.asChar()) && !FRRAnimFile::isAnimFileName(fileName.asChar()))
 	{
-		vector<double> output = result(i);
-		unsigned int numOutputElem = output.size();
-		for (unsigned int j = 0; j<numOutputElem; j++)
-		{
-			fout << output(j) << " ";
-		}
-		fout << std::endl;
+		FRRDatFile::write(fileName.asChar(), result, numRows, numCols);
+		return;
 	}
-	fout.close();
+	FRRMatrixFile::save(fileName.asChar(), result, numRows, numCols, names);
+}
+
+// This function trains rbfn on the ROE data files (same data as FRRTraining -bfn -cfn)
+bool FRRTRAININGCmd::trainFromFiles(rbf& rbfn, const MString& blendFile, const MString& cvFile)
+{
+	rbfMatrixView input, output;
+	FRRDataCache::Matrix humanFace = importMatrix(blendFile, input);
+	FRRDataCache::Matrix cartoonFace = importMatrix(cvFile, output);
+	if (!humanFace || !cartoonFace || input.rows == 0 || input.rows != output.rows) return false;
+
+	return rbfn.Train(input, output) == 0;
 }
\ No newline at end of file
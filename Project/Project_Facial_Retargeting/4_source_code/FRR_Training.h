@@ -4,6 +4,7 @@
 
 #include "global.h"
 #include "rbfKernel.h"
+#include "FRR_dataCache.h"
 #include <iostream>
 
 class FRRTRAININGCmd : public MPxCommand
@@ -19,7 +20,9 @@ public:
 
 	static void split(std::string& text, std::string& separators, std::list<std::string>& words);
 	static std::vector<std::vector<double>> importData(MString& fileName);
-	static void exportData(vector<vector<double>> result, MString& fileName);
+	static FRRDataCache::Matrix importMatrix(const MString& fileName, rbfMatrixView& view);
+	static void exportData(const double* result, int numRows, int numCols, MString& fileName, const std::vector<std::string>& names = std::vector<std::string>());
+	static bool trainFromFiles(rbf& rbfn, const MString& blendFile, const MString& cvFile);
 
 private:
 	MDGModifier dgMod;
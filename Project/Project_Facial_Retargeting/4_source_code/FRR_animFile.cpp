@@ -0,0 +1,490 @@
+#include "FRR_animFile.h"
+#include "FRR_bundle.h"
+#include <fstream>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const char animMagic[4] = { 'F', 'R', 'R', 'A' };
+static const int animVersion = 1;
+static const double animMaxLevels = 1099511627776.0;	// 2^40 quantization levels per channel at most
+
+// How a channel is stored in a block
+enum { kConstant = 0, kDelta = 1, kLinear = 2 };
+
+static inline unsigned long long lowBits(unsigned long long x, int count)
+{
+	return (count >= 64) ? x : (x & ((1ULL << count) - 1));
+}
+
+static inline int bitLength(unsigned long long x)
+{
+	int length = 0;
+	for (; x; x >>= 1) length++;
+	return length;
+}
+
+static inline unsigned long long zigzag(long long x)
+{
+	return (x < 0) ? ((unsigned long long)(-(x + 1)) << 1) | 1 : (unsigned long long)x << 1;
+}
+
+static inline long long unzigzag(unsigned long long x)
+{
+	return (x & 1) ? -(long long)(x >> 1) - 1 : (long long)(x >> 1);
+}
+
+static inline int trailingZeros(unsigned int x)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return (int)index;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+// LSB first bit stream
+class BitWriter
+{
+public:
+	BitWriter(std::vector<unsigned char>& out) : _out(out), _acc(0), _fill(0) {}
+
+	void put(unsigned long long bits, int count)
+	{
+		if (count > 32)
+		{
+			put(bits, 32);
+			put(bits >> 32, count - 32);
+			return;
+		}
+		_acc |= lowBits(bits, count) << _fill;
+		_fill += count;
+		while (_fill >= 8)
+		{
+			_out.push_back((unsigned char)_acc);
+			_acc >>= 8;
+			_fill -= 8;
+		}
+	}
+
+	// Rice code : (u >> k) in unary, then the low k bits. Long prefixes are replaced by the
+	// escape (FRR_ANIM_ESCAPE ones) followed by the length of u and u itself.
+	void putRice(unsigned long long u, int k)
+	{
+		unsigned long long high = u >> k;
+		if (high < FRR_ANIM_ESCAPE)
+		{
+			put((1ULL << high) - 1, (int)high + 1);
+			put(u, k);
+		}
+		else
+		{
+			int length = bitLength(u);
+			put((1ULL << FRR_ANIM_ESCAPE) - 1, FRR_ANIM_ESCAPE);
+			put(length - 1, 6);
+			put(u, length);
+		}
+	}
+
+	void putValue(unsigned long long u)
+	{
+		int length = bitLength(u);
+		put(length, 7);
+		put(u, length);
+	}
+
+	void flush()
+	{
+		if (_fill > 0) _out.push_back((unsigned char)_acc);
+		_acc = 0;
+		_fill = 0;
+	}
+
+private:
+	std::vector<unsigned char>&	_out;
+	unsigned long long			_acc;
+	int							_fill;
+};
+
+// Reads the stream of BitWriter. The data must be followed by 8 readable bytes.
+// Every read past limit (in bits) returns zeros and sets failed, so a corrupt block can not read
+// beyond its data and the 8 bytes after it.
+class BitReader
+{
+public:
+	BitReader(const char* data, size_t limit) : pos(0), failed(false), _data(data), _limit(limit) {}
+
+	unsigned long long peek()
+	{
+		if (pos > _limit) { failed = true; return 0; }
+		unsigned long long word;
+		memcpy(&word, _data + (pos >> 3), 8);
+		return word >> (pos & 7);
+	}
+
+	unsigned long long get(int count)
+	{
+		if (count > 32)
+		{
+			unsigned long long low = get(32);
+			return low | (get(count - 32) << 32);
+		}
+		unsigned long long bits = lowBits(peek(), count);
+		pos += count;
+		return bits;
+	}
+
+	unsigned long long getRice(int k)
+	{
+		int high = trailingZeros((unsigned int)~peek() | (1u << FRR_ANIM_ESCAPE));
+		if (high < FRR_ANIM_ESCAPE)
+		{
+			pos += high + 1;
+			return ((unsigned long long)high << k) | get(k);
+		}
+		pos += FRR_ANIM_ESCAPE;
+		int length = (int)get(6) + 1;
+		return get(length);
+	}
+
+	unsigned long long getValue()
+	{
+		return get((int)get(7));
+	}
+
+	size_t	pos;
+	bool	failed;		// a read went past limit
+
+private:
+	const char*	_data;
+	size_t		_limit;
+};
+
+// This function returns the bits of the rice codes of u with parameter k
+static long long riceCost(const unsigned long long* u, int n, int k)
+{
+	long long cost = 0;
+	for (int t = 0; t < n; t++)
+	{
+		unsigned long long high = u[t] >> k;
+		cost += (high < FRR_ANIM_ESCAPE) ? (long long)high + 1 + k : FRR_ANIM_ESCAPE + 6 + bitLength(u[t]);
+	}
+	return cost;
+}
+
+// This function picks the rice parameter of u around log2 of the mean
+static int riceParameter(const unsigned long long* u, int n, long long& cost)
+{
+	unsigned long long sum = 0;
+	for (int t = 0; t < n; t++) sum += u[t];
+	int guess = bitLength(sum / n);
+	int best = guess;
+	cost = riceCost(u, n, guess);
+	for (int k = guess - 2; k <= guess + 1; k++)
+	{
+		if (k < 0 || k > 56 || k == guess) continue;
+		long long c = riceCost(u, n, k);
+		if (c < cost) { cost = c; best = k; }
+	}
+	return best;
+}
+
+// This function encodes the quantized frames q (count x cols, row major) of one block
+static void encodeBlock(const long long* q, int count, int cols, std::vector<unsigned char>& out)
+{
+	BitWriter writer(out);
+	std::vector<unsigned long long> delta(count), linear(count);
+	for (int j = 0; j < cols; j++)
+	{
+		const long long first = q[j];
+		bool constant = true;
+		for (int t = 1; t < count; t++)
+		{
+			long long d = q[(size_t)t * cols + j] - q[(size_t)(t - 1) * cols + j];
+			long long p = (t >= 2) ? d - (q[(size_t)(t - 1) * cols + j] - q[(size_t)(t - 2) * cols + j]) : d;
+			delta[t - 1] = zigzag(d);
+			linear[t - 1] = zigzag(p);
+			if (d != 0) constant = false;
+		}
+
+		if (constant)
+		{
+			writer.put(kConstant, 2);
+			writer.putValue(first);
+			continue;
+		}
+		long long deltaCost, linearCost;
+		int deltaK = riceParameter(&delta[0], count - 1, deltaCost);
+		int linearK = riceParameter(&linear[0], count - 1, linearCost);
+		const bool useLinear = linearCost < deltaCost;
+		const unsigned long long* u = useLinear ? &linear[0] : &delta[0];
+		const int k = useLinear ? linearK : deltaK;
+
+		writer.put(useLinear ? kLinear : kDelta, 2);
+		writer.putValue(first);
+		writer.put(k, 6);
+		for (int t = 0; t < count - 1; t++) writer.putRice(u[t], k);
+	}
+	writer.flush();
+}
+
+
+bool FRRAnimFile::open(const char* fileName)
+{
+	close();
+	std::string bundleName, sectionName;
+	if (FRRBundle::splitPath(fileName, bundleName, sectionName))
+	{
+		const char* data;
+		size_t size;
+		if (!FRRBundle::mapSection(fileName, FRRBundle::kDataset, _file, data, size)) return false;
+		if (!attach(data, size)) { close(); return false; }
+		return true;
+	}
+	if (!_file.open(fileName)) return false;
+	if (!attach(_file.data, _file.size)) { close(); return false; }
+	return true;
+}
+
+// This function checks the header, the sizes and the block offsets of an animation file in memory
+bool FRRAnimFile::attach(const char* data, size_t size)
+{
+	_header = NULL;
+	_names.clear();
+	if (data == NULL || size < sizeof(FRRAnimHeader)) return false;
+
+	const FRRAnimHeader* header = (const FRRAnimHeader*)data;
+	if (memcmp(header->magic, animMagic, 4) != 0 || header->version != animVersion) return false;
+	if (header->rows < 0 || header->cols < 0 || header->blockFrames <= 0) return false;
+	if (header->numBlocks != (header->rows + header->blockFrames - 1LL) / header->blockFrames) return false;
+
+	// Sizes are compared as differences, so that no sum of header values can overflow
+	const long long fileSize = (long long)size;
+	const long long tableSize = (header->numBlocks + 1LL) * sizeof(long long);
+	if (header->nameOffset != (long long)(sizeof(FRRAnimHeader) + 2 * (size_t)header->cols * sizeof(double))) return false;
+	if (header->nameSize < 0 || header->blockOffset < header->nameOffset || header->blockOffset % (long long)sizeof(long long) != 0) return false;
+	if (header->nameSize > header->blockOffset - header->nameOffset) return false;
+	if (header->blockOffset > fileSize || tableSize > fileSize - header->blockOffset) return false;
+
+	const long long* blockOffset = (const long long*)(data + header->blockOffset);
+	if (blockOffset[0] < header->blockOffset + tableSize) return false;
+	for (int b = 0; b < header->numBlocks; b++)
+	{
+		if (blockOffset[b + 1] < blockOffset[b]) return false;
+	}
+	if (blockOffset[header->numBlocks] > fileSize - 8) return false;
+
+	// Channel names
+	const char* name = data + header->nameOffset;
+	const char* nameEnd = name + header->nameSize;
+	for (int j = 0; j < header->cols; j++)
+	{
+		const char* end = (const char*)memchr(name, '\0', nameEnd - name);
+		if (end == NULL) return false;
+		_names.push_back(std::string(name, end));
+		name = end + 1;
+	}
+
+	_header = header;
+	_base = (const double*)(data + sizeof(FRRAnimHeader));
+	_step = _base + header->cols;
+	_blockOffset = blockOffset;
+	_data = data;
+	return true;
+}
+
+void FRRAnimFile::close()
+{
+	_file.close();
+	_header = NULL;
+	_names.clear();
+}
+
+// This function decodes the frames of block into values (frames of the block x cols, row major)
+bool FRRAnimFile::decodeBlock(int block, double* values) const
+{
+	if (_header == NULL || block < 0 || block >= _header->numBlocks) return false;
+	const int cols = _header->cols;
+	const int first = block * _header->blockFrames;
+	const int count = std::min(_header->blockFrames, _header->rows - first);
+	const size_t limit = (size_t)(_blockOffset[block + 1] - _blockOffset[block]) * 8;
+
+	BitReader reader(_data + _blockOffset[block], limit);
+	for (int j = 0; j < cols; j++)
+	{
+		const double base = _base[j], step = _step[j];
+		const int mode = (int)reader.get(2);
+		long long q = (long long)reader.getValue();
+		values[j] = base + step * q;
+		if (mode == kConstant)
+		{
+			for (int t = 1; t < count; t++) values[(size_t)t * cols + j] = values[j];
+		}
+		else
+		{
+			// Sums in unsigned arithmetic : a corrupt block wraps around instead of overflowing
+			const int k = (int)reader.get(6);
+			unsigned long long d = 0, u = (unsigned long long)q;
+			for (int t = 1; t < count && reader.pos <= limit; t++)
+			{
+				unsigned long long r = (unsigned long long)unzigzag(reader.getRice(k));
+				d = (mode == kLinear && t >= 2) ? d + r : r;
+				u += d;
+				values[(size_t)t * cols + j] = base + step * (long long)u;
+			}
+		}
+		if (reader.failed || reader.pos > limit) return false;
+	}
+	return true;
+}
+
+// This function decodes all the frames, the blocks in parallel
+bool FRRAnimFile::decode(double* values) const
+{
+	if (_header == NULL) return false;
+	const int numBlock = _header->numBlocks;
+	int numFailed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:numFailed) if (numBlock > 1)
+	for (int b = 0; b < numBlock; b++)
+	{
+		if (!decodeBlock(b, values + (size_t)b * _header->blockFrames * _header->cols)) numFailed++;
+	}
+	return numFailed == 0;
+}
+
+// This function decodes count frames from first. Only the blocks holding them are decoded.
+bool FRRAnimFile::decodeFrames(int first, int count, double* values) const
+{
+	if (_header == NULL || first < 0 || count < 0 || first + count > _header->rows) return false;
+	const int cols = _header->cols, blockFrames = _header->blockFrames;
+	std::vector<double> buffer;
+	for (int frame = first; frame < first + count; )
+	{
+		const int block = frame / blockFrames;
+		const int blockFirst = block * blockFrames;
+		const int blockCount = std::min(blockFrames, _header->rows - blockFirst);
+		const int n = std::min(blockFirst + blockCount, first + count) - frame;
+		double* out = values + (size_t)(frame - first) * cols;
+		if (frame == blockFirst && n == blockCount)
+		{
+			if (!decodeBlock(block, out)) return false;
+		}
+		else
+		{
+			buffer.resize((size_t)blockCount * cols);
+			if (!decodeBlock(block, &buffer[0])) return false;
+			std::copy(buffer.begin() + (size_t)(frame - blockFirst) * cols, buffer.begin() + (size_t)(frame - blockFirst + n) * cols, out);
+		}
+		frame += n;
+	}
+	return true;
+}
+
+bool FRRAnimFile::isAnimFileName(const char* fileName)
+{
+	size_t length = strlen(fileName), extLength = strlen(FRR_ANIM_EXT);
+	if (length < extLength) return false;
+	const char* ext = fileName + length - extLength;
+	for (size_t i = 0; i < extLength; i++)
+	{
+		if (tolower(ext[i]) != FRR_ANIM_EXT[i]) return false;
+	}
+	return true;
+}
+
+// This function compresses values (rows x cols, row major doubles) into an animation file.
+// tolerance gives the largest error of each channel (one value for all the channels, or cols values).
+bool FRRAnimFile::write(const char* fileName, const double* values, int rows, int cols,
+						const std::vector<std::string>& names, const std::vector<double>& tolerance, int blockFrames)
+{
+	if (blockFrames <= 0 || tolerance.empty() || (tolerance.size() != 1 && (int)tolerance.size() != cols)) return false;
+
+	// Quantization of each channel
+	std::vector<double> base(cols, DBL_MAX), step(cols, 1.0), colMax(cols, -DBL_MAX);
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++)
+		{
+			double v = values[(size_t)i * cols + j];
+			if (!(v >= -DBL_MAX && v <= DBL_MAX)) return false;
+			if (v < base[j]) base[j] = v;
+			if (v > colMax[j]) colMax[j] = v;
+		}
+	}
+	for (int j = 0; j < cols; j++)
+	{
+		double tol = tolerance[(tolerance.size() == 1) ? 0 : j];
+		if (!(tol > 0.0)) return false;
+		if (rows == 0) base[j] = 0.0;
+		step[j] = std::max(2.0 * tol, (rows > 0) ? (colMax[j] - base[j]) / animMaxLevels : 0.0);
+	}
+
+	// Blocks
+	const int numBlock = (rows + blockFrames - 1) / blockFrames;
+	std::vector<std::vector<unsigned char>> blocks(numBlock);
+#pragma omp parallel for schedule(dynamic) if (numBlock > 1)
+	for (int b = 0; b < numBlock; b++)
+	{
+		const int first = b * blockFrames;
+		const int count = std::min(blockFrames, rows - first);
+		std::vector<long long> q((size_t)count * cols);
+		for (int t = 0; t < count; t++)
+		{
+			for (int j = 0; j < cols; j++)
+			{
+				q[(size_t)t * cols + j] = (long long)floor((values[(size_t)(first + t) * cols + j] - base[j]) / step[j] + 0.5);
+			}
+		}
+		encodeBlock(&q[0], count, cols, blocks[b]);
+	}
+
+	std::string nameBlock;
+	for (int j = 0; j < cols; j++)
+	{
+		if (j < (int)names.size()) nameBlock += names[j];
+		nameBlock += '\0';
+	}
+
+	FRRAnimHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, animMagic, 4);
+	header.version = animVersion;
+	header.rows = rows;
+	header.cols = cols;
+	header.blockFrames = blockFrames;
+	header.numBlocks = numBlock;
+	header.nameOffset = sizeof(FRRAnimHeader) + 2LL * cols * sizeof(double);
+	header.nameSize = nameBlock.size();
+	header.blockOffset = (header.nameOffset + header.nameSize + sizeof(long long) - 1) / sizeof(long long) * sizeof(long long);
+
+	std::vector<long long> blockOffset(numBlock + 1);
+	blockOffset[0] = header.blockOffset + (numBlock + 1LL) * sizeof(long long);
+	for (int b = 0; b < numBlock; b++) blockOffset[b + 1] = blockOffset[b] + blocks[b].size();
+
+	std::ofstream fout(fileName, std::ios::binary);
+	if (!fout.is_open()) return false;
+	fout.write((const char*)&header, sizeof(header));
+	if (cols > 0)
+	{
+		fout.write((const char*)&base[0], cols * sizeof(double));
+		fout.write((const char*)&step[0], cols * sizeof(double));
+	}
+	fout.write(nameBlock.data(), nameBlock.size());
+	const char padding[8] = { 0 };
+	fout.write(padding, header.blockOffset - header.nameOffset - header.nameSize);
+	fout.write((const char*)&blockOffset[0], blockOffset.size() * sizeof(long long));
+	for (int b = 0; b < numBlock; b++)
+	{
+		if (!blocks[b].empty()) fout.write((const char*)&blocks[b][0], blocks[b].size());
+	}
+	fout.write(padding, 8);		// BitReader reads 8 bytes at once
+	return fout.good();
+}
@@ -0,0 +1,79 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRANIMFILE
+#define _FRRANIMFILE
+
+#include "FRR_datFile.h"
+#include <vector>
+#include <string>
+
+#define FRR_ANIM_EXT		".fra"	// file name extension of the compressed animation files
+#define FRR_ANIM_BLOCK		64		// frames of one independently decodable block
+#define FRR_ANIM_TOLERANCE	1e-5	// default largest error of a decoded value
+#define FRR_ANIM_ESCAPE		24		// longest unary prefix of a rice code, longer values are escaped
+
+// Header of a compressed animation file (64 bytes, little endian).
+// It is followed by the base and the quantization step of each channel (doubles), the channel
+// names (zero terminated strings), the offsets of the blocks (numBlocks + 1 long longs, from the
+// start of the file) and the blocks.
+struct FRRAnimHeader
+{
+	char		magic[4];		// "FRRA"
+	int			version;
+	int			rows;			// frames
+	int			cols;			// channels
+	int			blockFrames;
+	int			numBlocks;
+	long long	nameOffset;
+	long long	nameSize;
+	long long	blockOffset;	// offset table
+	long long	reserved[2];
+};
+
+// Compressed animation file (.fra) of the retargeting results and the source weights.
+// Each channel j is quantized to base[j] + step[j] * n with step[j] = max(2 * tolerance[j], range[j] / 2^40),
+// so no decoded value is off by more than its tolerance (plus the rounding of base + step * n), unless
+// the range of the channel needs more than 2^40 levels : then the error is at most step[j] / 2.
+// In each block of blockFrames frames, every channel is stored as constant, as deltas or as the
+// residuals of a linear prediction (whichever is smaller), and the residuals are rice coded with
+// the best parameter of the block. The blocks are independent : frames are decoded at random
+// and the blocks are decoded in parallel.
+// open() also takes a dataset of a bundle holding an animation file ("koko.frb:humanSource", see FRRBundle).
+class FRRAnimFile
+{
+public:
+	FRRAnimFile() : _header(NULL) {}
+
+	bool	open(const char* fileName);
+	bool	attach(const char* data, size_t size);		// view of an animation file already in memory
+	void	close();
+
+	int		rows() const					{ return _header ? _header->rows : 0; }
+	int		cols() const					{ return _header ? _header->cols : 0; }
+	int		numBlocks() const				{ return _header ? _header->numBlocks : 0; }
+	int		blockFrames() const				{ return _header->blockFrames; }
+	double	colStep(int j) const			{ return _step[j]; }
+	const std::string& colName(int j) const	{ return _names[j]; }
+	long long	compressedSize() const		{ return _header ? _blockOffset[_header->numBlocks] : 0; }
+	const char*	fileData() const			{ return _data; }
+	size_t		fileSize() const			{ return _header ? (size_t)_blockOffset[_header->numBlocks] + 8 : 0; }	// with the padding
+
+	bool	decode(double* values) const;									// all the frames (rows x cols, row major)
+	bool	decodeBlock(int block, double* values) const;					// frames of one block
+	bool	decodeFrames(int first, int count, double* values) const;		// any range of frames
+
+	static bool	isAnimFileName(const char* fileName);
+	static bool	write(const char* fileName, const double* values, int rows, int cols,
+					  const std::vector<std::string>& names, const std::vector<double>& tolerance,
+					  int blockFrames = FRR_ANIM_BLOCK);
+
+private:
+	FRRMappedFile				_file;
+	const FRRAnimHeader*		_header;
+	const double*				_base;
+	const double*				_step;
+	const long long*			_blockOffset;
+	const char*					_data;
+	std::vector<std::string>	_names;
+};
+
+#endif
@@ -1,7 +1,13 @@
 //FRRBlendExport -bn "targetBlend" -bfn "humanSourceAnimation.dat" -f 360 
 //FRRBlendExport -bn "targetBlend" -bfn "humanROE.dat" -f 36
+//FRRBlendExport -bn "targetBlend" -bfn "humanROE.frm" -f 36
+//FRRBlendExport -bn "targetBlend" -bn "browBlend" -bfn "humanSourceAnimation.dat" -f 360
+//
+// The -bn flag can be used several times, the weights of the nodes are concatenated in this order.
 
 #include "FRR_blendExport.h"
+#include "FRR_matrixFile.h"
+#include "FRR_retarget.h"
 
 const char *blendNodeNameFlag = "-bn", *blendNodeNameLongFlag = "-blendNodeName";
 const char *blendExportFileNameFlag = "-bfn", *blendExportFileNameLongFlag = "-blendFileName";
@@ -12,6 +18,7 @@ MSyntax FRRBLENDEXPORTCmd::newSyntax()
 {
 	MSyntax syntax;
 	syntax.addFlag(blendNodeNameFlag, blendNodeNameLongFlag, MSyntax::kString);
+	syntax.makeFlagMultiUse(blendNodeNameFlag);
 	syntax.addFlag(blendExportFileNameFlag, blendExportFileNameLongFlag, MSyntax::kString);
 	syntax.addFlag(frameFlag, frameLongFlag, MSyntax::kDouble);
 
@@ -20,22 +27,21 @@ MSyntax FRRBLENDEXPORTCmd::newSyntax()
 
 MStatus FRRBLENDEXPORTCmd::doIt(const MArgList &args)
 {
-	MString blendNodeName;
+	MStringArray blendNodeNames;
 	MString blendExportFileName;
 	int frameNum = 0;
 
 	MArgDatabase argData(syntax(), args);
-	if (argData.isFlagSet(blendNodeNameFlag))
-		argData.getFlagArgument(blendNodeNameFlag, 0, blendNodeName);
+	for (unsigned int i = 0; i < argData.numberOfFlagUses(blendNodeNameFlag); i++) {
+		MArgList flagArgs;
+		argData.getFlagArgumentList(blendNodeNameFlag, i, flagArgs);
+		blendNodeNames.append(flagArgs.asString(0));
+	}
 	if (argData.isFlagSet(blendExportFileNameFlag))
 		argData.getFlagArgument(blendExportFileNameFlag, 0, blendExportFileName);
 	if (argData.isFlagSet(frameFlag))
 		argData.getFlagArgument(frameFlag, 0, frameNum);
 
-	//open the export file
-	ofstream fout;
-	fout.open(blendExportFileName.asChar());
-
 	//---------------------------------------------------------------TODO---------------------------------------------------------------//
 	//	Write your code here! (20~30 lines)																								//
 	//	1. select blendshape node by name																								//
@@ -51,32 +57,30 @@ MStatus FRRBLENDEXPORTCmd::doIt(const MArgList &args)
 	//	Given example, "humanSourceAnimation.mb" should generate 360x35 matrix, "humanROE.mb" should generate 36x35 matrix				//
 	//----------------------------------------------------------------------------------------------------------------------------------//
 
-	// Select blendshape node by name
-	MGlobal::selectByName(blendNodeName, MGlobal::kReplaceList);
-	MSelectionList selected;
-	MGlobal::getSelectionListByName(blendNodeName, selected);
-
-	MObject blendNode;
-	selected.getDependNode(0, blendNode);
-	
-	// Get blendshape weights at each frames
-	for (int i = 1; i <= frameNum; i++) {
-		// View the next frame
-		MGlobal::viewFrame(i);
-		
-		// Get blendshape weights
-		MFnBlendShapeDeformer bnDeformer(blendNode);
-		int bnNumWeights = bnDeformer.numWeights();
-
-		// Write down on the file
-		for (int j = 0; j < bnNumWeights; j++) {
-			fout << bnDeformer.weight(j) <<" ";
+	// Find the weight plugs of the blendshape nodes (and their names, the aliases of the weight plugs)
+	std::vector<MPlug> weightPlugs;
+	std::vector<std::string> names;
+	for (unsigned int n = 0; n < blendNodeNames.length(); n++) {
+		size_t firstName = names.size();
+		MStatus stat = FRRRETARGETCmd::findBlendWeightPlugs(blendNodeNames[n], weightPlugs, &names);
+		if (!stat) {
+			stat.perror("Cannot find the blendshape node " + blendNodeNames[n]);
+			return stat;
+		}
+
+		// With several nodes the names are prefixed by the node name, so they stay unique
+		if (blendNodeNames.length() > 1) {
+			for (size_t j = firstName; j < names.size(); j++) names[j] = std::string(blendNodeNames[n].asChar()) + "." + names[j];
 		}
-		fout << endl;
 	}
 
-	//close the export file
-	fout.close();
+	// Get blendshape weights at each frames, without changing the current frame
+	// (weights keyed by anim curves are sampled from the curves, the others are evaluated in a DG context)
+	std::vector<double> values;
+	if (frameNum > 0) FRRRETARGETCmd::samplePlugs(weightPlugs, 1, frameNum, values);
+
+	// Write down on the file (.dat, or binary matrix file for .frm)
+	FRRMatrixFile::save(blendExportFileName.asChar(), values.empty() ? NULL : &values[0], frameNum, (int)weightPlugs.size(), names);
 
 	return redoIt();
 }
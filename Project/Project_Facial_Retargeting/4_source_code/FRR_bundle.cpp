@@ -0,0 +1,258 @@
+#include "FRR_bundle.h"
+#include "FRR_matrixFile.h"
+#include "rbfKernel.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <climits>
+
+static const char bundleMagic[4] = { 'F', 'R', 'R', 'B' };
+static const int bundleVersion = 1;
+
+// This function checks the header and the table of contents of a bundle in memory
+static bool checkBundle(const char* data, size_t size, const FRRBundleHeader*& header, const FRRBundleEntry*& toc)
+{
+	if (data == NULL || size < sizeof(FRRBundleHeader)) return false;
+
+	const FRRBundleHeader* h = (const FRRBundleHeader*)data;
+	if (memcmp(h->magic, bundleMagic, 4) != 0 || h->version != bundleVersion) return false;
+	// Sizes are compared as differences and quotients, so that no header value can overflow them
+	const long long fileSize = (long long)size;
+	if (h->tocCount < 0 || h->tocCount > INT_MAX || h->tocOffset < (long long)sizeof(FRRBundleHeader) || h->tocOffset % FRR_BUNDLE_ALIGN != 0) return false;
+	if (h->tocOffset > fileSize || h->tocCount > (fileSize - h->tocOffset) / (long long)sizeof(FRRBundleEntry)) return false;
+
+	const FRRBundleEntry* t = (const FRRBundleEntry*)(data + h->tocOffset);
+	for (long long i = 0; i < h->tocCount; i++)
+	{
+		if (t[i].offset < (long long)sizeof(FRRBundleHeader) || t[i].offset % FRR_BUNDLE_ALIGN != 0) return false;
+		if (t[i].size < 0 || t[i].offset > fileSize || t[i].size > fileSize - t[i].offset) return false;
+		if (memchr(t[i].name, '\0', FRR_BUNDLE_NAME) == NULL) return false;
+	}
+	header = h;
+	toc = t;
+	return true;
+}
+
+// Index of the section named name in the table of contents, -1 if there is none
+static int findSection(const FRRBundleEntry* toc, int count, const std::string& name, int type)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (toc[i].type == type && name == toc[i].name) return i;
+	}
+	return -1;
+}
+
+
+bool FRRBundle::open(const char* fileName)
+{
+	close();
+	if (!_file.open(fileName)) return false;
+	if (!checkBundle(_file.data, _file.size, _header, _toc)) { close(); return false; }
+	return true;
+}
+
+void FRRBundle::close()
+{
+	_file.close();
+	_header = NULL;
+	_toc = NULL;
+}
+
+int FRRBundle::find(const std::string& name, Type type) const
+{
+	return findSection(_toc, numSections(), name, type);
+}
+
+// This function reads the words (e.g. controller.attribute) of a channel section
+bool FRRBundle::channels(const std::string& name, std::vector<std::string>& words) const
+{
+	int i = find(name, kChannels);
+	if (i < 0) return false;
+
+	words.clear();
+	const char* p = data(i);
+	const char* end = p + _toc[i].size;
+	while (p < end)
+	{
+		const char* stop = (const char*)memchr(p, '\0', end - p);
+		if (stop == NULL) stop = end;
+		if (stop > p) words.push_back(std::string(p, stop));
+		p = stop + 1;
+	}
+	return true;
+}
+
+// This function loads a trained network of a model section (see rbf::Save)
+bool FRRBundle::model(const std::string& name, rbf& rbfn) const
+{
+	int i = find(name, kModel);
+	return i >= 0 && rbfn.Load(data(i), (size_t)_toc[i].size) == 0;
+}
+
+bool FRRBundle::meta(const std::string& name, std::string& value) const
+{
+	int i = find(name, kMeta);
+	if (i < 0) return false;
+	value.assign(data(i), (size_t)_toc[i].size);
+	return true;
+}
+
+// This function appends the sections to a bundle (created if the file does not exist) :
+// the sections, then the new table of contents are written at the end of the file, and the
+// header is updated last, so the file stays valid (with its old contents) if writing fails.
+bool FRRBundle::append(const char* fileName, const std::vector<Section>& sections)
+{
+	for (size_t s = 0; s < sections.size(); s++)
+	{
+		if (sections[s].name.empty() || sections[s].name.size() >= FRR_BUNDLE_NAME) return false;
+	}
+
+	std::vector<FRRBundleEntry> toc;
+	long long end = 0;
+	{
+		FRRMappedFile file;
+		const FRRBundleHeader* header;
+		const FRRBundleEntry* oldToc;
+		if (file.open(fileName) && file.size > 0)
+		{
+			// Never write over something else than a bundle
+			if (!checkBundle(file.data, file.size, header, oldToc)) return false;
+			toc.assign(oldToc, oldToc + header->tocCount);
+			end = file.size;
+		}
+	}
+
+	std::fstream fout;
+	if (end > 0) fout.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
+	else fout.open(fileName, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!fout.is_open()) return false;
+
+	FRRBundleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, bundleMagic, 4);
+	header.version = bundleVersion;
+	if (end == 0)
+	{
+		fout.write((const char*)&header, sizeof(header));
+		end = sizeof(header);
+	}
+
+	const char padding[FRR_BUNDLE_ALIGN] = { 0 };
+	fout.seekp(end);
+	for (size_t s = 0; s <= sections.size(); s++)
+	{
+		long long offset = (end + FRR_BUNDLE_ALIGN - 1) / FRR_BUNDLE_ALIGN * FRR_BUNDLE_ALIGN;
+		fout.write(padding, offset - end);
+		end = offset;
+		if (s == sections.size()) break;
+
+		// A section replaces the older one of the same type and name
+		const Section& section = sections[s];
+		int old = findSection(toc.empty() ? NULL : &toc[0], (int)toc.size(), section.name, section.type);
+		if (old >= 0) toc.erase(toc.begin() + old);
+
+		FRRBundleEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.type = section.type;
+		entry.offset = offset;
+		entry.size = section.data.size();
+		strcpy(entry.name, section.name.c_str());
+		toc.push_back(entry);
+
+		if (!section.data.empty()) fout.write(&section.data[0], section.data.size());
+		end += entry.size;
+	}
+
+	// New table of contents, then the header which points to it
+	header.tocOffset = end;
+	header.tocCount = toc.size();
+	if (!toc.empty()) fout.write((const char*)&toc[0], toc.size() * sizeof(FRRBundleEntry));
+	fout.flush();
+	if (!fout.good()) return false;
+	fout.seekp(0);
+	fout.write((const char*)&header, sizeof(header));
+	fout.close();
+	return !fout.fail();
+}
+
+// This function makes a dataset section : values (rows x cols, row major doubles) as a binary
+// matrix file with the column names
+bool FRRBundle::datasetSection(Section& section, const std::string& name, const double* values, int rows, int cols,
+							   const std::vector<std::string>& names)
+{
+	std::ostringstream stream(std::ios::binary);
+	if (!FRRMatrixFile::write(stream, values, rows, cols, names)) return false;
+
+	const std::string bytes = stream.str();
+	section.type = kDataset;
+	section.name = name;
+	section.data.assign(bytes.begin(), bytes.end());
+	return true;
+}
+
+// This function makes a section of zero terminated words (channel layout)
+void FRRBundle::wordsSection(Section& section, Type type, const std::string& name, const std::vector<std::string>& words)
+{
+	section.type = type;
+	section.name = name;
+	section.data.clear();
+	for (size_t i = 0; i < words.size(); i++)
+	{
+		section.data.insert(section.data.end(), words[i].begin(), words[i].end());
+		section.data.push_back('\0');
+	}
+}
+
+bool FRRBundle::modelSection(Section& section, const std::string& name, const rbf& rbfn)
+{
+	section.type = kModel;
+	section.name = name;
+	return rbfn.Save(section.data) == 0;
+}
+
+bool FRRBundle::isBundleFileName(const char* fileName)
+{
+	size_t length = strlen(fileName), extLength = strlen(FRR_BUNDLE_EXT);
+	if (length < extLength) return false;
+	const char* ext = fileName + length - extLength;
+	for (size_t i = 0; i < extLength; i++)
+	{
+		if (tolower(ext[i]) != FRR_BUNDLE_EXT[i]) return false;
+	}
+	return true;
+}
+
+// This function splits a section path "koko.frb:humanROE" into the bundle file and the section
+// name, returns false for other paths
+bool FRRBundle::splitPath(const char* path, std::string& fileName, std::string& name)
+{
+	const size_t extLength = strlen(FRR_BUNDLE_EXT);
+	for (const char* p = strchr(path, ':'); p != NULL; p = strchr(p + 1, ':'))
+	{
+		std::string file(path, p);
+		if (p[1] == '\0' || !isBundleFileName(file.c_str()) || file.size() == extLength) continue;
+		fileName = file;
+		name = p + 1;
+		return true;
+	}
+	return false;
+}
+
+// This function maps the bundle of a section path into file and returns the bytes of the section
+bool FRRBundle::mapSection(const char* path, Type type, FRRMappedFile& file, const char*& data, size_t& size)
+{
+	std::string fileName, name;
+	if (!splitPath(path, fileName, name) || !file.open(fileName.c_str())) return false;
+
+	const FRRBundleHeader* header;
+	const FRRBundleEntry* toc;
+	int i = checkBundle(file.data, file.size, header, toc) ? findSection(toc, (int)header->tocCount, name, type) : -1;
+	if (i < 0) { file.close(); return false; }
+
+	data = file.data + toc[i].offset;
+	size = (size_t)toc[i].size;
+	return true;
+}
+
@@ -0,0 +1,92 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRBUNDLE
+#define _FRRBUNDLE
+
+#include "FRR_datFile.h"
+#include <vector>
+#include <string>
+
+#define FRR_BUNDLE_EXT		".frb"	// file name extension of the bundle files
+#define FRR_BUNDLE_ALIGN	64		// alignment of the sections in the file (bytes)
+#define FRR_BUNDLE_NAME		48		// longest section name (bytes, with the terminating zero)
+
+class rbf;
+
+// Header of a bundle file (32 bytes, little endian)
+struct FRRBundleHeader
+{
+	char		magic[4];		// "FRRB"
+	int			version;
+	long long	tocOffset;		// table of contents, written by the last append
+	long long	tocCount;		// number of FRRBundleEntry in it
+	long long	reserved;
+};
+
+// Entry of the table of contents (72 bytes)
+struct FRRBundleEntry
+{
+	int			type;			// FRRBundle::Type
+	int			reserved;
+	long long	offset;			// multiple of FRR_BUNDLE_ALIGN
+	long long	size;
+	char		name[FRR_BUNDLE_NAME];
+};
+
+// Retargeting project bundle (.frb) : one file holding the named sections of a setup, i.e. the
+// datasets (ROE data, animations, results), the controller channel layout, trained models and
+// metadata, with a table of contents for random access.
+// - Datasets are binary matrix files (see FRRMatrixFile) at aligned offsets, so they are used in
+//   place in the mapped bundle, or compressed animation files (FRRAnimFile), decoded from it.
+//   The other commands read them with the path "koko.frb:humanROE" (FRRMatrixFile::open,
+//   FRRAnimFile::open, FRRDatFile::read and the data cache understand it).
+// - append() writes the new sections and a new table of contents at the end of the file, then
+//   updates the header : nothing already written is rewritten or moved. A section appended with
+//   the name of an older one of the same type replaces it (the old bytes stay unused).
+// Like the matrix file readers it does not depend on Maya, the FRRBundle command is in FRR_bundleCmd.
+class FRRBundle
+{
+public:
+	enum Type { kDataset = 1, kChannels = 2, kModel = 3, kMeta = 4 };
+
+	// Section to append
+	struct Section
+	{
+		Type				type;
+		std::string			name;
+		std::vector<char>	data;
+	};
+
+	FRRBundle() : _header(NULL), _toc(NULL) {}
+
+	bool	open(const char* fileName);
+	void	close();
+
+	int						numSections() const		{ return _header ? (int)_header->tocCount : 0; }
+	const FRRBundleEntry&	entry(int i) const		{ return _toc[i]; }
+	const char*				data(int i) const		{ return _file.data + _toc[i].offset; }
+	int						find(const std::string& name, Type type) const;
+
+	bool	channels(const std::string& name, std::vector<std::string>& words) const;
+	bool	model(const std::string& name, rbf& rbfn) const;
+	bool	meta(const std::string& name, std::string& value) const;
+
+	static bool	append(const char* fileName, const std::vector<Section>& sections);
+	static bool	datasetSection(Section& section, const std::string& name, const double* values, int rows, int cols,
+							   const std::vector<std::string>& names);
+	static void	wordsSection(Section& section, Type type, const std::string& name, const std::vector<std::string>& words);
+	static bool	modelSection(Section& section, const std::string& name, const rbf& rbfn);
+
+	static bool	isBundleFileName(const char* fileName);
+	static bool	splitPath(const char* path, std::string& fileName, std::string& name);
+	static bool	mapSection(const char* path, Type type, FRRMappedFile& file, const char*& data, size_t& size);
+
+private:
+	FRRBundle(const FRRBundle&);
+	FRRBundle& operator=(const FRRBundle&);
+
+	FRRMappedFile			_file;
+	const FRRBundleHeader*	_header;
+	const FRRBundleEntry*	_toc;
+};
+
+#endif
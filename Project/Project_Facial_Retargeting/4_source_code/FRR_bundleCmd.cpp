@@ -0,0 +1,156 @@
+//FRRBundle -f "koko.frb" -ad "humanROE.dat"
+//FRRBundle -f "koko.frb" -ad "kokoROE.frm"
+//FRRBundle -f "koko.frb" -ad "humanSourceAnimation.dat"
+//FRRBundle -f "koko.frb" -ad "kokoFinalResult.fra"
+//FRRBundle -f "koko.frb" -acl "kokoCtrlList.dat"
+//FRRBundle -f "koko.frb" -amd "koko.mb" -n "scene"
+//FRRBundle -f "koko.frb" -l
+//FRRTraining -bfn "koko.frb:humanROE" -cfn "koko.frb:kokoROE" -sfn "koko.frb:humanSourceAnimation" -ffn "kokoFinalResult.dat"
+
+#include "FRR_bundleCmd.h"
+#include "FRR_matrixFile.h"
+#include "FRR_animFile.h"
+#include "FRR_dataCache.h"
+
+static const char* typeNames[] = { "", "dataset", "channels", "model", "meta" };
+
+const char *bundleFileFlag = "-f", *bundleFileLongFlag = "-file";
+const char *bundleAddDataFlag = "-ad", *bundleAddDataLongFlag = "-addData";
+const char *bundleAddCtrlListFlag = "-acl", *bundleAddCtrlListLongFlag = "-addCtrlList";
+const char *bundleAddMetaFlag = "-amd", *bundleAddMetaLongFlag = "-addMetadata";
+const char *bundleNameFlag = "-n", *bundleNameLongFlag = "-name";
+const char *bundleListFlag = "-l", *bundleListLongFlag = "-list";
+
+// Section name of a file : its name without the directory and the extension
+static std::string baseName(const MString& fileName)
+{
+	std::string name(fileName.asChar());
+	size_t slash = name.find_last_of("/\\:");
+	if (slash != std::string::npos) name = name.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	if (dot != std::string::npos && dot > 0) name = name.substr(0, dot);
+	return name;
+}
+
+MSyntax FRRBUNDLECmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(bundleFileFlag, bundleFileLongFlag, MSyntax::kString);
+	syntax.addFlag(bundleAddDataFlag, bundleAddDataLongFlag, MSyntax::kString);
+	syntax.addFlag(bundleAddCtrlListFlag, bundleAddCtrlListLongFlag, MSyntax::kString);
+	syntax.addFlag(bundleAddMetaFlag, bundleAddMetaLongFlag, MSyntax::kString);
+	syntax.addFlag(bundleNameFlag, bundleNameLongFlag, MSyntax::kString);
+	syntax.addFlag(bundleListFlag, bundleListLongFlag);
+	return syntax;
+}
+
+MStatus FRRBUNDLECmd::doIt(const MArgList &args)
+{
+	MString bundleName, dataName, ctrlListName, metaValue, sectionName;
+	MArgDatabase argData(syntax(), args);
+	if (argData.isFlagSet(bundleFileFlag))
+		argData.getFlagArgument(bundleFileFlag, 0, bundleName);
+	if (argData.isFlagSet(bundleAddDataFlag))
+		argData.getFlagArgument(bundleAddDataFlag, 0, dataName);
+	if (argData.isFlagSet(bundleAddCtrlListFlag))
+		argData.getFlagArgument(bundleAddCtrlListFlag, 0, ctrlListName);
+	if (argData.isFlagSet(bundleAddMetaFlag))
+		argData.getFlagArgument(bundleAddMetaFlag, 0, metaValue);
+	if (argData.isFlagSet(bundleNameFlag))
+		argData.getFlagArgument(bundleNameFlag, 0, sectionName);
+
+	MStatus stat(MStatus::kFailure);
+	int numAdd = (dataName.length() > 0) + (ctrlListName.length() > 0) + argData.isFlagSet(bundleAddMetaFlag);
+	if (bundleName.length() == 0 || numAdd > 1) {
+		stat.perror("FRRBundle needs -file, and at most one of -addData, -addCtrlList and -addMetadata!");
+		return stat;
+	}
+
+	std::vector<FRRBundle::Section> sections(numAdd);
+	if (dataName.length() > 0)
+	{
+		std::string name = (sectionName.length() > 0) ? sectionName.asChar() : baseName(dataName);
+		FRRAnimFile anim;
+		if (anim.open(dataName.asChar()))
+		{
+			// A compressed animation stays compressed in the bundle
+			sections[0].type = FRRBundle::kDataset;
+			sections[0].name = name;
+			sections[0].data.assign(anim.fileData(), anim.fileData() + anim.fileSize());
+		}
+		else
+		{
+			// Dataset in any other matrix format, with the column names of a binary file
+			FRRDatFile dat;
+			if (!dat.read(dataName.asChar()) || dat.numCols < 0) {
+				stat.perror("Cannot read " + dataName);
+				return stat;
+			}
+			std::vector<std::string> names;
+			FRRMatrixFile matrix;
+			if (matrix.open(dataName.asChar()))
+			{
+				for (int j = 0; j < matrix.cols(); j++) names.push_back(matrix.colName(j));
+			}
+			if (!FRRBundle::datasetSection(sections[0], name, dat.values.empty() ? NULL : &dat.values[0], dat.numRows(), dat.numCols, names)) {
+				stat.perror("Cannot store " + dataName + " as a dataset");
+				return stat;
+			}
+		}
+	}
+	else if (ctrlListName.length() > 0)
+	{
+		FRRDataCache::WordList words = FRRDataCache::wordList(ctrlListName.asChar());
+		if (!words) {
+			stat.perror("Cannot read " + ctrlListName);
+			return stat;
+		}
+		std::string name = (sectionName.length() > 0) ? sectionName.asChar() : baseName(ctrlListName);
+		FRRBundle::wordsSection(sections[0], FRRBundle::kChannels, name, *words);
+	}
+	else if (numAdd > 0)
+	{
+		if (sectionName.length() == 0) {
+			stat.perror("FRRBundle -addMetadata needs -name!");
+			return stat;
+		}
+		sections[0].type = FRRBundle::kMeta;
+		sections[0].name = sectionName.asChar();
+		sections[0].data.assign(metaValue.asChar(), metaValue.asChar() + metaValue.length());
+	}
+
+	if (numAdd > 0 && !FRRBundle::append(bundleName.asChar(), sections)) {
+		stat.perror("Cannot append to " + bundleName + " (not a bundle, or the name is longer than 47 characters)");
+		return stat;
+	}
+
+	// List the sections as type:name
+	MStringArray result;
+	if (argData.isFlagSet(bundleListFlag) || numAdd == 0)
+	{
+		FRRBundle bundle;
+		if (!bundle.open(bundleName.asChar())) {
+			stat.perror("Cannot read " + bundleName);
+			return stat;
+		}
+		for (int i = 0; i < bundle.numSections(); i++)
+		{
+			const FRRBundleEntry& entry = bundle.entry(i);
+			int type = (entry.type >= FRRBundle::kDataset && entry.type <= FRRBundle::kMeta) ? entry.type : 0;
+			MString section(typeNames[type]);
+			section += ":";
+			section += entry.name;
+			result.append(section);
+
+			MString info("FRRBundle: ");
+			info += section;
+			info += ", ";
+			info += (double)entry.size;
+			info += " bytes";
+			MGlobal::displayInfo(info);
+		}
+	}
+
+	setResult(result);
+	return MS::kSuccess;
+}
@@ -0,0 +1,20 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRBUNDLECmd
+#define _FRRBUNDLECmd
+
+#include "global.h"
+#include "FRR_bundle.h"
+
+// FRRBundle -f "koko.frb" [-ad file | -acl file | -amd value] [-n name] [-l] :
+// appends a dataset, a controller list or a metadata value to a bundle, or lists its sections
+class FRRBUNDLECmd : public MPxCommand
+{
+public:
+	virtual MStatus	doIt(const MArgList&);
+	virtual bool isUndoable() const { return false; }
+
+	static void *creator() { return new FRRBUNDLECmd; }
+	static MSyntax newSyntax();
+};
+
+#endif
@@ -0,0 +1,392 @@
+//FRRCapture -start -bfn "humanROE.dat" -cfn "kokoROE.dat" -port 9000
+//FRRCapture -start -bfn "humanROE.dat" -cfn "kokoROE.dat" -ffn "kokoLiveResult.dat" -replay "humanSourceAnimation.dat" -fps 30
+//FRRCapture -latest
+//FRRCapture -stats
+//FRRCapture -stop
+
+// Sockets first (winsock2.h has to come before windows.h)
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET FRRSocket;
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int FRRSocket;
+#define INVALID_SOCKET	(-1)
+#define closesocket		close
+#endif
+
+#include "FRR_capture.h"
+#include "FRR_Training.h"
+#include "FRR_matrixFile.h"
+#include <maya/MDoubleArray.h>
+#include <chrono>
+#include <cstring>
+
+static const char captureMagic[4] = { 'F', 'R', 'R', 'L' };
+
+FRRCapture* FRRCapture::active = NULL;
+
+
+FRRCapture::FRRCapture()
+	: received(0), lost(0), dropped(0), evaluated(0), publishDropped(0), latencySum(0), latencyMax(0),
+	  _port(0), _socket((std::uintptr_t)INVALID_SOCKET), _writing(false), _written(true), _running(false), _replaying(false), _inRing(NULL), _outRing(NULL)
+{
+	model.setBasisFunc(rbf::BF_HARDY);
+	model.setLamda(0.1);		// same as FRRTraining
+}
+
+FRRCapture::~FRRCapture()
+{
+	stop();
+}
+
+double FRRCapture::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// This function opens the socket and starts the receiver, consumer (and writer) threads.
+// The model has to be trained before.
+bool FRRCapture::start(int port, const std::string& finalFile)
+{
+	if (_running || model.getNumCenters() == 0) return false;
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return false;
+#endif
+
+	FRRSocket sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET) return false;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);		// local tracker only
+	if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		closesocket(sock);
+		return false;
+	}
+
+	// Wake up the receiver regularly, so it sees stop()
+#ifdef _WIN32
+	DWORD timeout = 100;
+#else
+	timeval timeout = { 0, 100000 };
+#endif
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+	_port = port;
+	_socket = (std::uintptr_t)sock;
+	_inRing = new FRRRingBuffer<double>(FRR_CAPTURE_RING, FRR_FRAME_HEADER + model._dimInput);
+	_outRing = new FRRRingBuffer<double>(FRR_CAPTURE_RING, FRR_FRAME_HEADER + model._dimOutput);
+	_writing = !finalFile.empty();
+	_written = !_writing;
+
+	_running = true;
+	_receiver = std::thread(&FRRCapture::receive, this);
+	_consumer = std::thread(&FRRCapture::evaluate, this);
+	if (_writing) _writer = std::thread(&FRRCapture::write, this, finalFile);
+	return true;
+}
+
+bool FRRCapture::stop()
+{
+	_running = false;
+	if (_replayer.joinable()) _replayer.join();
+	if (_receiver.joinable()) _receiver.join();
+	if (_consumer.joinable()) _consumer.join();
+	if (_writer.joinable()) _writer.join();
+
+	if ((FRRSocket)_socket != INVALID_SOCKET)
+	{
+		closesocket((FRRSocket)_socket);
+		_socket = (std::uintptr_t)INVALID_SOCKET;
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+	delete _inRing;
+	delete _outRing;
+	_inRing = NULL;
+	_outRing = NULL;
+	return _written;
+}
+
+// Receiver thread : socket -> input ring
+void FRRCapture::receive()
+{
+	const int dim = model._dimInput;
+	std::vector<char> packet(sizeof(FRRCapturePacket) + dim * sizeof(double));
+	std::vector<double> frame(FRR_FRAME_HEADER + dim);
+	unsigned int expected = 0;
+
+	while (_running)
+	{
+		int size = recv((FRRSocket)_socket, &packet[0], (int)packet.size(), 0);
+		if (size <= 0) continue;		// timeout
+
+		// Ignore anything else than a frame of the right dimension
+		FRRCapturePacket header;
+		memcpy(&header, &packet[0], sizeof(header));
+		if (size != (int)packet.size() || memcmp(header.magic, captureMagic, 4) != 0) continue;
+
+		if (received > 0 && header.sequence > expected) lost += header.sequence - expected;
+		expected = header.sequence + 1;
+		received++;
+
+		frame[0] = header.sequence;
+		frame[1] = header.sendTime;
+		frame[2] = now();
+		memcpy(&frame[FRR_FRAME_HEADER], &packet[sizeof(header)], dim * sizeof(double));
+		if (!_inRing->push(&frame[0])) dropped++;
+	}
+}
+
+// Consumer thread : input ring -> rbf -> output ring
+void FRRCapture::evaluate()
+{
+	std::vector<double> in(_inRing->frameSize()), out(_outRing->frameSize());
+
+	while (_running)
+	{
+		if (!_inRing->pop(&in[0]))
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			continue;
+		}
+
+		model.Interpolate(&in[FRR_FRAME_HEADER], &out[FRR_FRAME_HEADER]);
+		for (int k = 0; k < FRR_FRAME_HEADER; k++) out[k] = in[k];
+
+		if (!_outRing->push(&out[0])) publishDropped++;
+		evaluated++;
+
+		long long latency = (long long)((now() - in[1]) * 1e6);
+		latencySum += latency;
+		long long latencyPrev = latencyMax;
+		while (latency > latencyPrev && !latencyMax.compare_exchange_weak(latencyPrev, latency));
+	}
+}
+
+// Writer thread : output ring -> result rows, saved in the format of the final result file at stop()
+void FRRCapture::write(std::string finalFile)
+{
+	const int dim = _outRing->frameSize() - FRR_FRAME_HEADER;
+	std::vector<double> out(_outRing->frameSize());
+	std::vector<double> rows;
+
+	while (_running || _outRing->size() > 0)
+	{
+		if (!_outRing->pop(&out[0]))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		rows.insert(rows.end(), out.begin() + FRR_FRAME_HEADER, out.end());
+	}
+
+	const int numRows = (dim > 0) ? rows.size() / dim : 0;
+	_written = FRRMatrixFile::save(finalFile.c_str(), rows.empty() ? NULL : &rows[0], numRows, dim, std::vector<std::string>());
+}
+
+// This function returns the newest controller values, and discards the older ones.
+// Not available while the results are written to a file (the ring has a single consumer).
+bool FRRCapture::latest(std::vector<double>& values)
+{
+	if (!_running || _writing) return false;
+
+	std::vector<double> out(_outRing->frameSize());
+	bool found = false;
+	while (_outRing->pop(&out[0])) found = true;
+	if (found) values.assign(out.begin() + FRR_FRAME_HEADER, out.end());
+	return found;
+}
+
+// This function streams the frames of a .dat file to the port of the ingest at fps,
+// as a stand-in for the tracker.
+bool FRRCapture::replay(const std::string& sourceFile, double fps)
+{
+	if (!_running || _replaying || fps <= 0.0) return false;
+	if (_replayer.joinable()) _replayer.join();		// the last replay is finished
+
+	MString fileName(sourceFile.c_str());
+	std::vector<std::vector<double>> WVec = FRRTRAININGCmd::importData(fileName);
+	if (WVec.size() == 0) return false;
+
+	_replaying = true;
+	_replayer = std::thread(&FRRCapture::send, this, WVec, fps);
+	return true;
+}
+
+// Replay thread
+void FRRCapture::send(std::vector<std::vector<double>> frames, double fps)
+{
+	FRRSocket sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET) { _replaying = false; return; }
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)_port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	std::vector<char> packet;
+	double startTime = now();
+	for (unsigned int i = 0; i < frames.size() && _running; i++)
+	{
+		// Keep the frame rate of the tracker
+		double frameTime = startTime + i / fps;
+		while (now() < frameTime && _running)
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+
+		FRRCapturePacket header;
+		memcpy(header.magic, captureMagic, 4);
+		header.sequence = i;
+		header.sendTime = now();
+
+		packet.resize(sizeof(header) + frames[i].size() * sizeof(double));
+		memcpy(&packet[0], &header, sizeof(header));
+		memcpy(&packet[sizeof(header)], &frames[i][0], frames[i].size() * sizeof(double));
+		sendto(sock, &packet[0], (int)packet.size(), 0, (sockaddr*)&addr, sizeof(addr));
+	}
+	closesocket(sock);
+	_replaying = false;
+}
+
+
+
+const char *captureStartFlag = "-st", *captureStartLongFlag = "-start";
+const char *captureStopFlag = "-sp", *captureStopLongFlag = "-stop";
+const char *capturePortFlag = "-p", *capturePortLongFlag = "-port";
+const char *captureBlendFileFlag = "-bfn", *captureBlendFileLongFlag = "-blendFileName";
+const char *captureCVFileFlag = "-cfn", *captureCVFileLongFlag = "-cvFileName";
+const char *captureFinalFileFlag = "-ffn", *captureFinalFileLongFlag = "-finalFileName";
+const char *captureReplayFlag = "-rp", *captureReplayLongFlag = "-replay";
+const char *captureFpsFlag = "-fps", *captureFpsLongFlag = "-framesPerSecond";
+const char *captureStatsFlag = "-s", *captureStatsLongFlag = "-stats";
+const char *captureLatestFlag = "-l", *captureLatestLongFlag = "-latest";
+
+MSyntax FRRCAPTURECmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(captureStartFlag, captureStartLongFlag);
+	syntax.addFlag(captureStopFlag, captureStopLongFlag);
+	syntax.addFlag(capturePortFlag, capturePortLongFlag, MSyntax::kLong);
+	syntax.addFlag(captureBlendFileFlag, captureBlendFileLongFlag, MSyntax::kString);
+	syntax.addFlag(captureCVFileFlag, captureCVFileLongFlag, MSyntax::kString);
+	syntax.addFlag(captureFinalFileFlag, captureFinalFileLongFlag, MSyntax::kString);
+	syntax.addFlag(captureReplayFlag, captureReplayLongFlag, MSyntax::kString);
+	syntax.addFlag(captureFpsFlag, captureFpsLongFlag, MSyntax::kDouble);
+	syntax.addFlag(captureStatsFlag, captureStatsLongFlag);
+	syntax.addFlag(captureLatestFlag, captureLatestLongFlag);
+	return syntax;
+}
+
+MStatus FRRCAPTURECmd::doIt(const MArgList &args)
+{
+	MString blendFile;
+	MString CVFile;
+	MString finalFile;
+	MString replayFile;
+	int port = FRR_CAPTURE_PORT;
+	double fps = 30.0;
+
+	MArgDatabase argData(syntax(), args);
+	if (argData.isFlagSet(capturePortFlag))
+		argData.getFlagArgument(capturePortFlag, 0, port);
+	if (argData.isFlagSet(captureBlendFileFlag))
+		argData.getFlagArgument(captureBlendFileFlag, 0, blendFile);
+	if (argData.isFlagSet(captureCVFileFlag))
+		argData.getFlagArgument(captureCVFileFlag, 0, CVFile);
+	if (argData.isFlagSet(captureFinalFileFlag))
+		argData.getFlagArgument(captureFinalFileFlag, 0, finalFile);
+	if (argData.isFlagSet(captureReplayFlag))
+		argData.getFlagArgument(captureReplayFlag, 0, replayFile);
+	if (argData.isFlagSet(captureFpsFlag))
+		argData.getFlagArgument(captureFpsFlag, 0, fps);
+
+	MStatus stat;
+
+	if (argData.isFlagSet(captureStopFlag))
+	{
+		if (FRRCapture::active != NULL && !FRRCapture::active->stop()) {
+			stat = MS::kFailure;
+			stat.perror("Cannot write the capture results!");
+		}
+		delete FRRCapture::active;
+		FRRCapture::active = NULL;
+		return stat;
+	}
+
+	if (argData.isFlagSet(captureStartFlag))
+	{
+		delete FRRCapture::active;
+		FRRCapture::active = new FRRCapture();
+
+		if (!FRRTRAININGCmd::trainFromFiles(FRRCapture::active->model, blendFile, CVFile)) {
+			delete FRRCapture::active;
+			FRRCapture::active = NULL;
+			stat = MS::kFailure;
+			stat.perror("Cannot read the ROE data!");
+			return stat;
+		}
+		if (!FRRCapture::active->start(port, finalFile.asChar())) {
+			delete FRRCapture::active;
+			FRRCapture::active = NULL;
+			stat = MS::kFailure;
+			stat.perror("Cannot open the capture port!");
+			return stat;
+		}
+	}
+
+	FRRCapture* capture = FRRCapture::active;
+	if (capture == NULL)
+	{
+		stat = MS::kFailure;
+		stat.perror("No capture is running!");
+		return stat;
+	}
+
+	if (replayFile.length() > 0 && !capture->replay(replayFile.asChar(), fps))
+	{
+		stat = MS::kFailure;
+		stat.perror("Cannot replay " + replayFile);
+		return stat;
+	}
+
+	if (argData.isFlagSet(captureStatsFlag))
+	{
+		// received, lost, dropped, evaluated, publish dropped, mean latency (ms), max latency (ms)
+		long long numEvaluated = capture->evaluated;
+		MDoubleArray stats;
+		stats.append((double)capture->received);
+		stats.append((double)capture->lost);
+		stats.append((double)capture->dropped);
+		stats.append((double)numEvaluated);
+		stats.append((double)capture->publishDropped);
+		stats.append(numEvaluated > 0 ? capture->latencySum / (numEvaluated * 1000.0) : 0.0);
+		stats.append(capture->latencyMax / 1000.0);
+		setResult(stats);
+	}
+	else if (argData.isFlagSet(captureLatestFlag))
+	{
+		std::vector<double> values;
+		MDoubleArray result;
+		if (capture->latest(values))
+		{
+			for (unsigned int k = 0; k < values.size(); k++) result.append(values[k]);
+		}
+		setResult(result);
+	}
+
+	return MS::kSuccess;
+}
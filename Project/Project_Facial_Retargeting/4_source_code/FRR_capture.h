@@ -0,0 +1,85 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRCAPTURECmd
+#define _FRRCAPTURECmd
+
+#include "global.h"
+#include "rbfKernel.h"
+#include "FRR_ringBuffer.h"
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#define FRR_CAPTURE_PORT	9000	// default UDP port of the tracker stream
+#define FRR_CAPTURE_RING	256		// frames per ring
+#define FRR_FRAME_HEADER	3		// frame layout in the rings : sequence, send time, receive time, then the values
+
+// Datagram of the tracker stream, followed by the blendshape weights (double)
+struct FRRCapturePacket
+{
+	char			magic[4];		// "FRRL"
+	unsigned int	sequence;		// frame number of the sender
+	double			sendTime;		// seconds on the steady clock of the sender (same machine)
+};
+
+// Live capture ingest : a receiver thread reads the tracker frames from a local UDP socket into
+// the input ring, a consumer thread evaluates the rbf on each frame and publishes the controller
+// values to the output ring, which is drained by a file writer thread or by FRRCapture -latest.
+// The writer thread collects the results and saves them when the capture stops (.dat, .frm or
+// .fra, by the extension of the file name, see FRRMatrixFile::save).
+class FRRCapture
+{
+public:
+	FRRCapture();
+	~FRRCapture();
+
+	bool	start(int port, const std::string& finalFile);
+	bool	replay(const std::string& sourceFile, double fps);		// stream a .dat file to our own port
+	bool	stop();												// false if the results could not be written
+	bool	latest(std::vector<double>& values);					// newest controller values (main thread)
+
+	static double now();				// seconds on the steady clock
+	static FRRCapture* active;			// ingest started by FRRCapture -start
+
+	rbf		model;
+
+	// Counters
+	std::atomic<long long>	received;			// frames received
+	std::atomic<long long>	lost;				// frames missing in the sequence (lost by the network)
+	std::atomic<long long>	dropped;			// frames dropped because the input ring was full
+	std::atomic<long long>	evaluated;			// frames retargeted
+	std::atomic<long long>	publishDropped;		// results dropped because the output ring was full
+	std::atomic<long long>	latencySum;			// send -> publish, microseconds
+	std::atomic<long long>	latencyMax;
+
+private:
+	void	receive();
+	void	evaluate();
+	void	write(std::string finalFile);
+	void	send(std::vector<std::vector<double>> frames, double fps);
+
+	int						_port;
+	std::uintptr_t			_socket;
+	bool					_writing;
+	bool					_written;		// the writer thread saved the results (read after it is joined)
+	std::atomic<bool>		_running;
+	std::atomic<bool>		_replaying;		// the replay thread is sending (joined by the next replay() or stop())
+	FRRRingBuffer<double>*	_inRing;
+	FRRRingBuffer<double>*	_outRing;
+	std::thread				_receiver;
+	std::thread				_consumer;
+	std::thread				_writer;
+	std::thread				_replayer;
+};
+
+// FRRCapture -start / -stop / -stats / -latest : control the live capture ingest
+class FRRCAPTURECmd : public MPxCommand
+{
+public:
+	virtual MStatus	doIt(const MArgList&);
+	virtual bool isUndoable() const { return false; }
+
+	static void *creator() { return new FRRCAPTURECmd; }
+	static MSyntax newSyntax();
+};
+
+#endif
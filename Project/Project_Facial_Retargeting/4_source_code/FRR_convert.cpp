@@ -0,0 +1,129 @@
+//FRRConvert -i "kokoFinalResult.dat" -o "kokoFinalResult.frm"
+//FRRConvert -i "kokoFinalResult.dat" -o "kokoFinalResult.frm" -nfn "kokoAttrList.txt" -cm
+//FRRConvert -i "kokoFinalResult.frm" -o "kokoFinalResult.dat"
+//FRRConvert -i "kokoFinalResult.dat" -o "kokoFinalResult.fra" -tol 0.0001
+//FRRConvert -i "kokoFinalResult.dat" -o "kokoFinalResult.fra" -tfn "kokoTolerance.txt"
+
+#include "FRR_convert.h"
+#include "FRR_datFile.h"
+#include "FRR_matrixFile.h"
+#include "FRR_animFile.h"
+
+const char *convertInputFlag = "-i", *convertInputLongFlag = "-input";
+const char *convertOutputFlag = "-o", *convertOutputLongFlag = "-output";
+const char *convertNamesFlag = "-nfn", *convertNamesLongFlag = "-namesFileName";
+const char *convertColumnMajorFlag = "-cm", *convertColumnMajorLongFlag = "-columnMajor";
+const char *convertToleranceFlag = "-tol", *convertToleranceLongFlag = "-tolerance";
+const char *convertToleranceFileFlag = "-tfn", *convertToleranceFileLongFlag = "-toleranceFileName";
+
+MSyntax FRRCONVERTCmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(convertInputFlag, convertInputLongFlag, MSyntax::kString);
+	syntax.addFlag(convertOutputFlag, convertOutputLongFlag, MSyntax::kString);
+	syntax.addFlag(convertNamesFlag, convertNamesLongFlag, MSyntax::kString);
+	syntax.addFlag(convertColumnMajorFlag, convertColumnMajorLongFlag);
+	syntax.addFlag(convertToleranceFlag, convertToleranceLongFlag, MSyntax::kDouble);
+	syntax.addFlag(convertToleranceFileFlag, convertToleranceFileLongFlag, MSyntax::kString);
+	return syntax;
+}
+
+MStatus FRRCONVERTCmd::doIt(const MArgList &args)
+{
+	MString inputName, outputName, namesName, toleranceName;
+	double tolerance = FRR_ANIM_TOLERANCE;
+	MArgDatabase argData(syntax(), args);
+	if (argData.isFlagSet(convertInputFlag))
+		argData.getFlagArgument(convertInputFlag, 0, inputName);
+	if (argData.isFlagSet(convertOutputFlag))
+		argData.getFlagArgument(convertOutputFlag, 0, outputName);
+	if (argData.isFlagSet(convertNamesFlag))
+		argData.getFlagArgument(convertNamesFlag, 0, namesName);
+	if (argData.isFlagSet(convertToleranceFlag))
+		argData.getFlagArgument(convertToleranceFlag, 0, tolerance);
+	if (argData.isFlagSet(convertToleranceFileFlag))
+		argData.getFlagArgument(convertToleranceFileFlag, 0, toleranceName);
+
+	// Read the values (either format) and keep the column names of a binary file
+	FRRDatFile dat;
+	if (!dat.read(inputName.asChar())) {
+		MStatus stat(MStatus::kFailure);
+		stat.perror("Cannot read " + inputName);
+		return stat;
+	}
+	if (dat.numCols < 0) {
+		MStatus stat(MStatus::kFailure);
+		stat.perror("Rows of " + inputName + " have different lengths!");
+		return stat;
+	}
+	int rows = dat.numRows(), cols = dat.numCols;
+
+	std::vector<std::string> names;
+	FRRMatrixFile inputMatrix;
+	FRRAnimFile inputAnim;
+	if (inputMatrix.open(inputName.asChar()))
+	{
+		for (int j = 0; j < cols; j++) names.push_back(inputMatrix.colName(j));
+	}
+	else if (inputAnim.open(inputName.asChar()))
+	{
+		for (int j = 0; j < cols; j++) names.push_back(inputAnim.colName(j));
+	}
+
+	// Column names from a name list file (one word per column, e.g. controller.attribute)
+	if (namesName.length() > 0)
+	{
+		names.clear();
+		ifstream fin(namesName.asChar());
+		std::string word;
+		while (fin >> word) names.push_back(word);
+	}
+
+	const double* values = dat.values.empty() ? NULL : &dat.values[0];
+	bool ok;
+	if (FRRMatrixFile::isMatrixFileName(outputName.asChar()))
+	{
+		FRRMatrixFile::Layout layout = argData.isFlagSet(convertColumnMajorFlag) ? FRRMatrixFile::kColumnMajor : FRRMatrixFile::kRowMajor;
+		ok = FRRMatrixFile::write(outputName.asChar(), values, rows, cols, names, layout);
+	}
+	else if (FRRAnimFile::isAnimFileName(outputName.asChar()))
+	{
+		// Tolerance of each channel (one value per column), or one tolerance for all
+		std::vector<double> tolerances(1, tolerance);
+		if (toleranceName.length() > 0)
+		{
+			tolerances.clear();
+			ifstream fin(toleranceName.asChar());
+			double tol;
+			while (fin >> tol) tolerances.push_back(tol);
+		}
+		ok = FRRAnimFile::write(outputName.asChar(), values, rows, cols, names, tolerances);
+
+		FRRAnimFile outputAnim;
+		if (ok && outputAnim.open(outputName.asChar()))
+		{
+			FRRMappedFile inputFile;
+			inputFile.open(inputName.asChar());
+			MString info("FRRConvert: ");
+			info += (int)outputAnim.compressedSize();
+			info += " bytes, ratio ";
+			info += (outputAnim.compressedSize() > 0) ? (double)inputFile.size / outputAnim.compressedSize() : 0.0;
+			info += " to the input file and ";
+			info += (outputAnim.compressedSize() > 0) ? 8.0 * rows * cols / outputAnim.compressedSize() : 0.0;
+			info += " to the raw doubles";
+			MGlobal::displayInfo(info);
+		}
+	}
+	else
+	{
+		ok = FRRDatFile::write(outputName.asChar(), values, rows, cols, 0);
+	}
+	if (!ok) {
+		MStatus stat(MStatus::kFailure);
+		stat.perror("Cannot write " + outputName);
+		return stat;
+	}
+
+	setResult(rows);
+	return MS::kSuccess;
+}
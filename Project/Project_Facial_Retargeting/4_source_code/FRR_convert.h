@@ -0,0 +1,22 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRCONVERTCmd
+#define _FRRCONVERTCmd
+
+#include "global.h"
+
+// FRRConvert : converts a matrix between the .dat text format, the binary .frm format and the
+// compressed .fra animation format (the format of each file is given by its extension). .dat files
+// are written with the shortest digits which read back to the same doubles, so the conversion
+// between .dat and .frm is lossless both ways. .fra files keep each value within -tol (or the
+// tolerance of its column in -tfn) and the compression ratio is displayed.
+class FRRCONVERTCmd : public MPxCommand
+{
+public:
+	virtual MStatus	doIt(const MArgList&);
+	virtual bool isUndoable() const { return false; }
+
+	static void *creator() { return new FRRCONVERTCmd; }
+	static MSyntax newSyntax();
+};
+
+#endif
@@ -0,0 +1,459 @@
+#include "FRR_datFile.h"
+#include "FRR_matrixFile.h"
+#include "FRR_animFile.h"
+#include "FRR_bundle.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRR_DAT_SSE2
+#include <emmintrin.h>
+#endif
+
+// Powers of ten which are exact in double
+static const double exactPow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isSeparator(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline int bitCount(unsigned int x)
+{
+	int count = 0;
+	for (; x; x &= x - 1) count++;
+	return count;
+}
+
+// This function counts the numbers (runs of non separators) of a chunk.
+// 16 bytes are classified at once, a number starts where a separator is followed by another character.
+static size_t countValues(const char* p, size_t n)
+{
+	size_t count = 0;
+	unsigned int prevSep = 1;		// chunks start at the beginning of a line
+	size_t i = 0;
+#ifdef FRR_DAT_SSE2
+	const __m128i space = _mm_set1_epi8(' '), newline = _mm_set1_epi8('\n');
+	const __m128i ret = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)(p + i));
+		__m128i sep = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, space), _mm_cmpeq_epi8(c, newline)),
+								   _mm_or_si128(_mm_cmpeq_epi8(c, ret), _mm_cmpeq_epi8(c, tab)));
+		unsigned int sepMask = (unsigned int)_mm_movemask_epi8(sep);
+		unsigned int starts = ~sepMask & ((sepMask << 1) | prevSep) & 0xFFFF;
+		count += bitCount(starts);
+		prevSep = sepMask >> 15;
+	}
+#endif
+	for (; i < n; i++)
+	{
+		unsigned int sep = isSeparator(p[i]) ? 1 : 0;
+		if (!sep && prevSep) count++;
+		prevSep = sep;
+	}
+	return count;
+}
+
+// This function converts the number of [p, end).
+// Decimal numbers with at most 19 significant digits and a small exponent are exact in the
+// fast path (mantissa and power of ten are exact doubles, so one multiplication or division
+// rounds correctly). Anything else goes through strtod, so the result is always the same as strtod.
+static double parseValue(const char* p, const char* end)
+{
+	const char* s = p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+')) { negative = (*s == '-'); s++; }
+
+	unsigned long long mantissa = 0;
+	int numDigit = 0, numSignificant = 0, exponent = 0;
+	for (; s < end && *s >= '0' && *s <= '9'; s++, numDigit++)
+	{
+		if (numSignificant < 19) { mantissa = mantissa * 10 + (*s - '0'); if (mantissa) numSignificant++; }
+		else { exponent++; numSignificant = 20; }
+	}
+	if (s < end && *s == '.')
+	{
+		for (s++; s < end && *s >= '0' && *s <= '9'; s++, numDigit++)
+		{
+			if (numSignificant < 19) { mantissa = mantissa * 10 + (*s - '0'); exponent--; if (mantissa) numSignificant++; }
+			else numSignificant = 20;
+		}
+	}
+	if (numDigit > 0 && s < end && (*s == 'e' || *s == 'E'))
+	{
+		const char* e = s + 1;
+		bool negativeExp = false;
+		if (e < end && (*e == '-' || *e == '+')) { negativeExp = (*e == '-'); e++; }
+		int value = 0;
+		const char* first = e;
+		for (; e < end && *e >= '0' && *e <= '9' && value < 10000; e++) value = value * 10 + (*e - '0');
+		if (e > first) { exponent += negativeExp ? -value : value; s = e; }
+	}
+
+	if (numDigit > 0 && s == end && numSignificant <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double value = (double)mantissa;
+		value = (exponent < 0) ? value / exactPow10[-exponent] : value * exactPow10[exponent];
+		return negative ? -value : value;
+	}
+
+	char buffer[64];
+	size_t length = end - p;
+	if (length > sizeof(buffer) - 1) length = sizeof(buffer) - 1;
+	memcpy(buffer, p, length);
+	buffer[length] = '\0';
+	return strtod(buffer, NULL);
+}
+
+// This function parses the numbers of a chunk into values, and appends the offset of the first
+// value of each non empty line (numbers before are counted by first) to rowStart
+static void parseChunk(const char* p, size_t n, double* values, int first, std::vector<int>& rowStart)
+{
+	const char* end = p + n;
+	int count = 0;
+	bool lineHasValue = false;
+	while (p < end)
+	{
+		if (isSeparator(*p))
+		{
+			if (*p == '\n') lineHasValue = false;
+			p++;
+			continue;
+		}
+		const char* token = p;
+		while (p < end && !isSeparator(*p)) p++;
+		if (!lineHasValue) { rowStart.push_back(first + count); lineHasValue = true; }
+		values[count++] = parseValue(token, p);
+	}
+}
+
+
+#ifdef _WIN32
+FRRMappedFile::FRRMappedFile() : data(NULL), size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) {}
+#else
+FRRMappedFile::FRRMappedFile() : data(NULL), size(0), _file(-1) {}
+#endif
+
+bool FRRMappedFile::open(const char* fileName)
+{
+	close();
+#ifdef _WIN32
+	_file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(_file, &fileSize)) { close(); return false; }
+	size = (size_t)fileSize.QuadPart;
+	if (size == 0) return true;
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping != NULL) data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	_file = ::open(fileName, O_RDONLY);
+	if (_file < 0) return false;
+	struct stat info;
+	if (fstat(_file, &info) != 0) { close(); return false; }
+	size = (size_t)info.st_size;
+	if (size == 0) return true;
+
+	void* view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, _file, 0);
+	if (view != MAP_FAILED) data = (const char*)view;
+#endif
+	if (data == NULL) { close(); return false; }
+	return true;
+}
+
+void FRRMappedFile::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (_mapping) CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	_mapping = NULL;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void*)data, size);
+	if (_file >= 0) ::close(_file);
+	_file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+
+// This function copies the values of a binary matrix file
+static void copyMatrix(const FRRMatrixFile& matrix, FRRDatFile& dat)
+{
+	const int rows = matrix.rows(), cols = matrix.cols();
+	dat.values.resize((size_t)rows * cols);
+	if (!dat.values.empty()) matrix.copyRows(&dat.values[0]);
+	dat.rowPtr.resize(rows + 1);
+	for (int i = 0; i <= rows; i++) dat.rowPtr[i] = i * cols;
+	dat.numCols = cols;
+}
+
+// This function maps the file and parses it, or copies the values of a binary matrix file or
+// decodes a compressed animation file (also as a dataset of a bundle, "koko.frb:humanROE")
+bool FRRDatFile::read(const char* fileName)
+{
+	values.clear();
+	rowPtr.assign(1, 0);
+	numCols = 0;
+
+	FRRMappedFile file;
+	const char* data;
+	size_t size;
+	std::string bundleName, sectionName;
+	const bool section = FRRBundle::splitPath(fileName, bundleName, sectionName);
+	if (section)
+	{
+		if (!FRRBundle::mapSection(fileName, FRRBundle::kDataset, file, data, size)) return false;
+	}
+	else
+	{
+		if (!file.open(fileName)) return false;
+		data = file.data;
+		size = file.size;
+	}
+	if (size == 0) return !section;
+
+	FRRMatrixFile matrix;
+	if (matrix.attach(data, size))
+	{
+		copyMatrix(matrix, *this);
+		return true;
+	}
+	FRRAnimFile anim;
+	if (anim.attach(data, size))
+	{
+		const int rows = anim.rows(), cols = anim.cols();
+		values.resize((size_t)rows * cols);
+		if (!values.empty() && !anim.decode(&values[0])) return false;
+		rowPtr.resize(rows + 1);
+		for (int i = 0; i <= rows; i++) rowPtr[i] = i * cols;
+		numCols = cols;
+		return true;
+	}
+	return !section && parse(data, size);
+}
+
+// This function formats value (finite, nonzero) like printf %.<precision>g for small precisions.
+// The digits are rounded from value scaled by an exact power of ten (one rounding error), so the
+// result is exact unless the scaled value is too close to a rounding tie. Returns 0 in that
+// case and for the values out of the fast range, formatValue() uses sprintf then.
+static int formatShortG(char* out, double value, int precision)
+{
+	double a = fabs(value);
+	if (!(a >= 1e-300 && a <= 1e300)) return 0;
+
+	int e = (int)floor(log10(a));
+	const double low = exactPow10[precision - 1], high = exactPow10[precision];
+	double scaled = 0.0;
+	for (int retry = 0; retry < 2; retry++)
+	{
+		int k = precision - 1 - e;
+		if (k > 22 || k < -22) return 0;
+		scaled = (k >= 0) ? a * exactPow10[k] : a / exactPow10[-k];
+		if (scaled < low) e--;
+		else if (scaled >= high) e++;
+		else break;
+	}
+	if (scaled < low || scaled >= high) return 0;
+
+	double whole = floor(scaled);
+	double fraction = scaled - whole;
+	if (fabs(fraction - 0.5) <= scaled * 4e-16) return 0;
+	long long mantissa = (long long)whole + (fraction > 0.5 ? 1 : 0);
+	if (mantissa == (long long)high) { mantissa = (long long)low; e++; }
+
+	char digits[16];
+	int numDigit = precision;
+	for (int i = precision - 1; i >= 0; i--) { digits[i] = (char)('0' + mantissa % 10); mantissa /= 10; }
+	while (numDigit > 1 && digits[numDigit - 1] == '0') numDigit--;
+
+	char* p = out;
+	if (value < 0) *p++ = '-';
+	if (e < -4 || e >= precision)
+	{
+		// Scientific : d.ddde-05
+		*p++ = digits[0];
+		if (numDigit > 1) { *p++ = '.'; for (int i = 1; i < numDigit; i++) *p++ = digits[i]; }
+		*p++ = 'e';
+		*p++ = (e < 0) ? '-' : '+';
+		int ae = (e < 0) ? -e : e;
+		if (ae >= 100) *p++ = (char)('0' + ae / 100);
+		*p++ = (char)('0' + (ae / 10) % 10);
+		*p++ = (char)('0' + ae % 10);
+	}
+	else if (e >= 0)
+	{
+		for (int i = 0; i <= e; i++) *p++ = (i < numDigit) ? digits[i] : '0';
+		if (numDigit > e + 1) { *p++ = '.'; for (int i = e + 1; i < numDigit; i++) *p++ = digits[i]; }
+	}
+	else
+	{
+		*p++ = '0';
+		*p++ = '.';
+		for (int i = 0; i < -e - 1; i++) *p++ = '0';
+		for (int i = 0; i < numDigit; i++) *p++ = digits[i];
+	}
+	return (int)(p - out);
+}
+
+// This function formats value like ostream << with the given precision (printf %g) and returns
+// the number of characters. precision <= 0 writes the shortest of 15, 16 or 17 digits which reads
+// back to the same double. precision is clamped to FRR_DAT_MAX_PRECISION, so out needs
+// FRR_DAT_MAX_CHARS characters.
+int FRRDatFile::formatValue(char* out, double value, int precision)
+{
+	if (precision > FRR_DAT_MAX_PRECISION) precision = FRR_DAT_MAX_PRECISION;
+	if (value == 0.0)
+	{
+		// Most controllers are at rest in most frames
+		if (std::signbit(value)) { out[0] = '-'; out[1] = '0'; return 2; }
+		out[0] = '0';
+		return 1;
+	}
+	if (precision > 0)
+	{
+		int length = (precision <= 9) ? formatShortG(out, value, precision) : 0;
+		return (length > 0) ? length : sprintf(out, "%.*g", precision, value);
+	}
+
+	int length = 0;
+	for (int digits = 15; digits <= 17; digits++)
+	{
+		length = sprintf(out, "%.*g", digits, value);
+		if (strtod(out, NULL) == value) break;
+	}
+	return length;
+}
+
+// This function writes values (rows x cols, row major) as a .dat file (see the other write())
+bool FRRDatFile::write(const char* fileName, const double* values, int rows, int cols, int precision)
+{
+	std::vector<const double*> rowPtrs(rows);
+	for (int i = 0; i < rows; i++) rowPtrs[i] = values + (size_t)i * cols;
+	return write(fileName, rowPtrs.empty() ? NULL : &rowPtrs[0], rows, cols, precision);
+}
+
+// This function writes the rows as a .dat file : one row per line, each number followed by a space.
+// The default precision is the one of ofstream (6 digits), see formatValue(). Precisions over
+// FRR_DAT_MAX_PRECISION are clamped to it.
+// Blocks of FRR_DAT_BLOCK rows are formatted in parallel into their own buffers, which are written
+// in order with one call each, so there is no flush per row.
+bool FRRDatFile::write(const char* fileName, const double* const* rows, int numRows, int cols, int precision)
+{
+	FILE* fout = fopen(fileName, "w");
+	if (fout == NULL) return false;
+
+	bool ok = write(fout, rows, numRows, cols, precision);
+	if (fclose(fout) != 0) ok = false;
+	return ok;
+}
+
+// This function appends the rows to an open file (FRRTraining -pipeline writes the result chunk by chunk)
+bool FRRDatFile::write(FILE* fout, const double* const* rows, int numRows, int cols, int precision)
+{
+	if (precision > FRR_DAT_MAX_PRECISION) precision = FRR_DAT_MAX_PRECISION;
+	const int numBlock = (numRows + FRR_DAT_BLOCK - 1) / FRR_DAT_BLOCK;
+	std::vector<std::vector<char>> buffers(FRR_DAT_BATCH < numBlock ? FRR_DAT_BATCH : numBlock);
+	std::vector<size_t> lengths(buffers.size());
+	bool ok = true;
+
+	for (int b0 = 0; b0 < numBlock && ok; b0 += FRR_DAT_BATCH)
+	{
+		const int numBatch = (b0 + FRR_DAT_BATCH < numBlock) ? FRR_DAT_BATCH : numBlock - b0;
+#pragma omp parallel for schedule(dynamic) if (numBatch > 1)
+		for (int b = 0; b < numBatch; b++)
+		{
+			const int first = (b0 + b) * FRR_DAT_BLOCK;
+			const int last = (first + FRR_DAT_BLOCK < numRows) ? first + FRR_DAT_BLOCK : numRows;
+			std::vector<char>& buffer = buffers[b];
+			buffer.resize((size_t)(last - first) * ((size_t)cols * (FRR_DAT_MAX_CHARS + 1) + 1));
+
+			char* out = buffer.empty() ? NULL : &buffer[0];
+			for (int i = first; i < last; i++)
+			{
+				const double* row = rows[i];
+				for (int j = 0; j < cols; j++)
+				{
+					out += formatValue(out, row[j], precision);
+					*out++ = ' ';
+				}
+				*out++ = '\n';
+			}
+			lengths[b] = out - (buffer.empty() ? NULL : &buffer[0]);
+		}
+
+		for (int b = 0; b < numBatch && ok; b++)
+		{
+			if (lengths[b] > 0) ok = fwrite(&buffers[b][0], 1, lengths[b], fout) == lengths[b];
+		}
+	}
+	return ok;
+}
+
+// This function parses the text of a .dat file
+//   1. split it into chunks of about FRR_DAT_CHUNK bytes which end at a newline
+//   2. count the numbers of each chunk (in parallel), their prefix sums place the chunks in values
+//   3. parse each chunk into its place (in parallel), and join the row starts
+bool FRRDatFile::parse(const char* text, size_t size)
+{
+	std::vector<size_t> bound(1, 0);
+	while (bound.back() < size)
+	{
+		size_t next = bound.back() + FRR_DAT_CHUNK;
+		if (next >= size) next = size;
+		else
+		{
+			const char* newline = (const char*)memchr(text + next, '\n', size - next);
+			next = newline ? (newline - text) + 1 : size;
+		}
+		bound.push_back(next);
+	}
+	const int numChunk = (int)bound.size() - 1;
+
+	std::vector<size_t> chunkFirst(numChunk + 1, 0);
+#pragma omp parallel for schedule(dynamic) if (numChunk > 1)
+	for (int c = 0; c < numChunk; c++)
+	{
+		chunkFirst[c + 1] = countValues(text + bound[c], bound[c + 1] - bound[c]);
+	}
+	for (int c = 0; c < numChunk; c++) chunkFirst[c + 1] += chunkFirst[c];
+	if (chunkFirst[numChunk] > 0x7fffffff) return false;
+
+	values.resize(chunkFirst[numChunk]);
+	std::vector<std::vector<int>> chunkRows(numChunk);
+#pragma omp parallel for schedule(dynamic) if (numChunk > 1)
+	for (int c = 0; c < numChunk; c++)
+	{
+		parseChunk(text + bound[c], bound[c + 1] - bound[c], values.empty() ? NULL : &values[chunkFirst[c]], (int)chunkFirst[c], chunkRows[c]);
+	}
+
+	rowPtr.clear();
+	for (int c = 0; c < numChunk; c++) rowPtr.insert(rowPtr.end(), chunkRows[c].begin(), chunkRows[c].end());
+	rowPtr.push_back((int)values.size());
+
+	numCols = (numRows() > 0) ? rowSize(0) : 0;
+	for (int i = 1; i < numRows(); i++)
+	{
+		if (rowSize(i) != numCols) { numCols = -1; break; }
+	}
+	return true;
+}
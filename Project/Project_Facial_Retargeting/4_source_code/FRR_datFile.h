@@ -0,0 +1,68 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRDATFILE
+#define _FRRDATFILE
+
+#include <vector>
+#include <cstddef>
+#include <cstdio>
+
+#define FRR_DAT_CHUNK	(1 << 20)	// bytes of the file parsed by one task
+#define FRR_DAT_BLOCK	256			// rows formatted by one task when writing
+#define FRR_DAT_BATCH	64			// blocks formatted before they are written
+#define FRR_DAT_MAX_CHARS	32		// longest number written by formatValue()
+#define FRR_DAT_MAX_PRECISION	17	// larger precisions are clamped (17 digits read back exactly)
+
+// Read only memory mapping of a whole file (data is NULL for an empty file)
+class FRRMappedFile
+{
+public:
+	FRRMappedFile();
+	~FRRMappedFile()				{ close(); }
+
+	bool	open(const char* fileName);
+	void	close();
+
+	const char*	data;
+	size_t		size;
+
+private:
+	FRRMappedFile(const FRRMappedFile&);
+	FRRMappedFile& operator=(const FRRMappedFile&);
+
+#ifdef _WIN32
+	void*	_file;
+	void*	_mapping;
+#else
+	int		_file;
+#endif
+};
+
+// Whitespace separated rows of numbers (.dat files of the ROE data and the animations).
+// read() also takes binary matrix files (see FRRMatrixFile) and compressed animation files
+// (see FRRAnimFile), which are recognized by their header.
+// The file is memory mapped and split into newline aligned chunks, which are counted and parsed
+// in parallel straight into one contiguous array. Empty lines are skipped, and rows may have
+// different lengths (rowPtr works like the row pointers of CSR).
+class FRRDatFile
+{
+public:
+	FRRDatFile() : numCols(0) { rowPtr.assign(1, 0); }
+
+	bool	read(const char* fileName);
+	bool	parse(const char* text, size_t size);
+
+	static bool write(const char* fileName, const double* values, int rows, int cols, int precision = 6);
+	static bool write(const char* fileName, const double* const* rows, int numRows, int cols, int precision = 6);
+	static bool write(FILE* file, const double* const* rows, int numRows, int cols, int precision = 6);
+	static int	formatValue(char* out, double value, int precision);
+
+	int				numRows() const			{ return (int)rowPtr.size() - 1; }
+	int				rowSize(int i) const	{ return rowPtr[i + 1] - rowPtr[i]; }
+	const double*	row(int i) const		{ return &values[rowPtr[i]]; }
+
+	std::vector<double>	values;		// all the numbers, row by row
+	std::vector<int>	rowPtr;		// first value of each row, then the number of values
+	int					numCols;	// length of the rows, -1 if they differ
+};
+
+#endif
@@ -0,0 +1,258 @@
+//FRRCacheStats
+//FRRCacheStats -b 512
+//FRRCacheStats -c
+
+#include "FRR_dataCache.h"
+#include "FRR_bundle.h"
+#include <maya/MDoubleArray.h>
+#include <cstdlib>
+#include <cctype>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const char *cacheBudgetFlag = "-b", *cacheBudgetLongFlag = "-budget";
+const char *cacheClearFlag = "-c", *cacheClearLongFlag = "-clear";
+
+std::mutex							FRRDataCache::_lock;
+std::map<std::string, FRRDataCache::Entry>	FRRDataCache::_entries;
+std::list<std::string>				FRRDataCache::_uses;
+size_t								FRRDataCache::_budget = (size_t)FRR_DATA_CACHE_BUDGET << 20;
+FRRDataCache::Stats					FRRDataCache::_stats = { 0, 0, 0, 0, 0 };
+
+// This function gets the canonical path, the size and the modification time of a file.
+// A section of a bundle ("koko.frb:humanROE") is keyed by the bundle file and its name.
+bool FRRDataCache::fileKey(const char* fileName, std::string& path, long long& size, long long& mtime)
+{
+	std::string bundleName, sectionName;
+	if (FRRBundle::splitPath(fileName, bundleName, sectionName))
+	{
+		if (!fileKey(bundleName.c_str(), path, size, mtime)) return false;
+		path += ":" + sectionName;
+		return true;
+	}
+
+#ifdef _WIN32
+	char fullPath[MAX_PATH];
+	if (_fullpath(fullPath, fileName, MAX_PATH) == NULL) return false;
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(fullPath, GetFileExInfoStandard, &attributes)) return false;
+	if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) return false;
+	path = fullPath;
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		path[i] = (path[i] == '/') ? '\\' : (char)tolower(path[i]);
+	}
+	size = ((long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	mtime = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	char* fullPath = realpath(fileName, NULL);
+	if (fullPath == NULL) return false;
+	path = fullPath;
+	free(fullPath);
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return false;
+	size = info.st_size;
+#ifdef __APPLE__
+	mtime = info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+	mtime = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+// This function returns the data of key if the file has not changed, and marks it as used
+std::shared_ptr<const void> FRRDataCache::find(const std::string& key, long long size, long long mtime)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	std::map<std::string, Entry>::iterator it = _entries.find(key);
+	if (it == _entries.end() || it->second.size != size || it->second.mtime != mtime)
+	{
+		_stats.misses++;
+		return std::shared_ptr<const void>();
+	}
+	_uses.splice(_uses.begin(), _uses, it->second.use);
+	_stats.hits++;
+	return it->second.data;
+}
+
+void FRRDataCache::insert(const std::string& key, long long size, long long mtime, size_t bytes, const std::shared_ptr<const void>& data)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	std::map<std::string, Entry>::iterator it = _entries.find(key);
+	if (it != _entries.end())
+	{
+		_stats.bytes -= it->second.bytes;
+		_uses.erase(it->second.use);
+		_entries.erase(it);
+	}
+	if (bytes > _budget) return;		// never fits, the caller keeps its copy
+
+	evict(_budget - bytes);
+	Entry& entry = _entries[key];
+	entry.size = size;
+	entry.mtime = mtime;
+	entry.bytes = bytes;
+	entry.data = data;
+	_uses.push_front(key);
+	entry.use = _uses.begin();
+	_stats.bytes += bytes;
+}
+
+// This function evicts the least recently used entries until they take at most budget bytes.
+// The lock must be held.
+void FRRDataCache::evict(size_t budget)
+{
+	while (_stats.bytes > budget && !_uses.empty())
+	{
+		std::map<std::string, Entry>::iterator it = _entries.find(_uses.back());
+		_stats.bytes -= it->second.bytes;
+		_entries.erase(it);
+		_uses.pop_back();
+		_stats.evictions++;
+	}
+}
+
+FRRDataCache::Matrix FRRDataCache::matrix(const char* fileName)
+{
+	std::string path;
+	long long size, mtime;
+	if (!fileKey(fileName, path, size, mtime))
+	{
+		// Not a plain file, read it without caching
+		std::shared_ptr<FRRDatFile> dat(new FRRDatFile);
+		return dat->read(fileName) ? dat : Matrix();
+	}
+
+	const std::string key = "matrix:" + path;
+	Matrix cached = std::static_pointer_cast<const FRRDatFile>(find(key, size, mtime));
+	if (cached) return cached;
+
+	std::shared_ptr<FRRDatFile> dat(new FRRDatFile);
+	if (!dat->read(path.c_str())) return Matrix();
+	const size_t bytes = sizeof(FRRDatFile) + dat->values.capacity() * sizeof(double) + dat->rowPtr.capacity() * sizeof(int);
+	insert(key, size, mtime, bytes, dat);
+	return dat;
+}
+
+FRRDataCache::WordList FRRDataCache::wordList(const char* fileName)
+{
+	std::string path;
+	long long size, mtime;
+	const bool cacheable = fileKey(fileName, path, size, mtime);
+	const std::string key = "words:" + path;
+	if (cacheable)
+	{
+		WordList cached = std::static_pointer_cast<const std::vector<std::string>>(find(key, size, mtime));
+		if (cached) return cached;
+	}
+
+	std::shared_ptr<std::vector<std::string>> words(new std::vector<std::string>);
+	std::string bundleName, sectionName;
+	if (FRRBundle::splitPath(fileName, bundleName, sectionName))
+	{
+		// Channel section of a bundle
+		FRRBundle bundle;
+		if (!bundle.open(bundleName.c_str()) || !bundle.channels(sectionName, *words)) return WordList();
+	}
+	else
+	{
+		ifstream fin(fileName);
+		if (!fin.is_open()) return WordList();
+		std::string word;
+		while (fin >> word) words->push_back(word);
+	}
+	size_t bytes = sizeof(std::vector<std::string>);
+	for (size_t i = 0; i < words->size(); i++) bytes += sizeof(std::string) + (*words)[i].capacity();
+	if (cacheable) insert(key, size, mtime, bytes, words);
+	return words;
+}
+
+void FRRDataCache::setBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_budget = bytes;
+	evict(_budget);
+}
+
+size_t FRRDataCache::budget()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return _budget;
+}
+
+void FRRDataCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_entries.clear();
+	_uses.clear();
+	_stats.bytes = 0;
+}
+
+FRRDataCache::Stats FRRDataCache::stats()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	Stats result = _stats;
+	result.entries = (int)_entries.size();
+	return result;
+}
+
+
+MSyntax FRRCACHESTATSCmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(cacheBudgetFlag, cacheBudgetLongFlag, MSyntax::kDouble);
+	syntax.addFlag(cacheClearFlag, cacheClearLongFlag);
+	return syntax;
+}
+
+MStatus FRRCACHESTATSCmd::doIt(const MArgList &args)
+{
+	MArgDatabase argData(syntax(), args);
+	if (argData.isFlagSet(cacheClearFlag))
+		FRRDataCache::clear();
+	if (argData.isFlagSet(cacheBudgetFlag))
+	{
+		double budgetMB = FRR_DATA_CACHE_BUDGET;
+		argData.getFlagArgument(cacheBudgetFlag, 0, budgetMB);
+		if (budgetMB < 0.0) {
+			MStatus stat(MStatus::kFailure);
+			stat.perror("The cache budget must not be negative!");
+			return stat;
+		}
+		FRRDataCache::setBudget((size_t)(budgetMB * 1048576.0));
+	}
+
+	FRRDataCache::Stats stats = FRRDataCache::stats();
+	MDoubleArray result;
+	result.append(stats.entries);
+	result.append(stats.bytes / 1048576.0);
+	result.append((double)stats.hits);
+	result.append((double)stats.misses);
+	result.append((double)stats.evictions);
+
+	MString info("FRRCacheStats: ");
+	info += stats.entries;
+	info += " entries, ";
+	info += stats.bytes / 1048576.0;
+	info += " / ";
+	info += FRRDataCache::budget() / 1048576.0;
+	info += " MB, ";
+	info += (int)stats.hits;
+	info += " hits, ";
+	info += (int)stats.misses;
+	info += " misses, ";
+	info += (int)stats.evictions;
+	info += " evictions";
+	MGlobal::displayInfo(info);
+
+	setResult(result);
+	return MS::kSuccess;
+}
@@ -0,0 +1,78 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRDATACACHE
+#define _FRRDATACACHE
+
+#include "global.h"
+#include "FRR_datFile.h"
+#include <memory>
+#include <mutex>
+#include <list>
+#include <map>
+#include <string>
+
+#define FRR_DATA_CACHE_BUDGET	256		// default memory budget of the data cache (MB)
+
+// Plugin wide cache of the parsed data files (ROE data, animations, controller lists), so the
+// commands called again and again by the GUI on the same files skip the parsing. Sections of a
+// bundle ("koko.frb:humanROE", see FRRBundle) are cached like files.
+// An entry is keyed by the canonical path of the file and is valid while the size and the
+// modification time of the file are unchanged. Entries are shared immutably : a command keeps
+// its entry alive even if it is evicted meanwhile. The least recently used entries are evicted
+// when the cache grows over its budget. It is thread safe (FRRTraining -async reads through it).
+class FRRDataCache
+{
+public:
+	typedef std::shared_ptr<const FRRDatFile>				Matrix;
+	typedef std::shared_ptr<const std::vector<std::string>>	WordList;
+
+	static Matrix	matrix(const char* fileName);		// NULL if the file cannot be read
+	static WordList	wordList(const char* fileName);		// whitespace separated words
+
+	static void		setBudget(size_t bytes);
+	static size_t	budget();
+	static void		clear();
+
+	struct Stats
+	{
+		int			entries;
+		size_t		bytes;
+		long long	hits;
+		long long	misses;
+		long long	evictions;
+	};
+	static Stats	stats();
+
+private:
+	struct Entry
+	{
+		long long							size;
+		long long							mtime;
+		size_t								bytes;
+		std::shared_ptr<const void>			data;
+		std::list<std::string>::iterator	use;
+	};
+
+	static bool	fileKey(const char* fileName, std::string& path, long long& size, long long& mtime);
+	static std::shared_ptr<const void>	find(const std::string& key, long long size, long long mtime);
+	static void	insert(const std::string& key, long long size, long long mtime, size_t bytes, const std::shared_ptr<const void>& data);
+	static void	evict(size_t budget);
+
+	static std::mutex						_lock;
+	static std::map<std::string, Entry>		_entries;
+	static std::list<std::string>			_uses;		// most recently used first
+	static size_t							_budget;
+	static Stats							_stats;
+};
+
+// FRRCacheStats [-budget MB] [-clear] : reports the data cache (entries, MB, hits, misses, evictions)
+class FRRCACHESTATSCmd : public MPxCommand
+{
+public:
+	virtual MStatus	doIt(const MArgList&);
+	virtual bool isUndoable() const { return false; }
+
+	static void *creator() { return new FRRCACHESTATSCmd; }
+	static MSyntax newSyntax();
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "FRR_matrixFile.h"
+#include "FRR_animFile.h"
+#include "FRR_bundle.h"
+#include <fstream>
+#include <cstring>
+#include <cctype>
+#include <cfloat>
+
+static const char matrixMagic[4] = { 'F', 'R', 'R', 'M' };
+static const int matrixVersion = 1;
+
+
+bool FRRMatrixFile::open(const char* fileName)
+{
+	close();
+	std::string bundleName, sectionName;
+	if (FRRBundle::splitPath(fileName, bundleName, sectionName))
+	{
+		const char* data;
+		size_t size;
+		if (!FRRBundle::mapSection(fileName, FRRBundle::kDataset, _file, data, size)) return false;
+		if (!attach(data, size)) { close(); return false; }
+		return true;
+	}
+	if (!_file.open(fileName)) return false;
+	if (!attach(_file.data, _file.size)) { close(); return false; }
+	return true;
+}
+
+// This function checks the header and the sizes of a matrix file in memory
+bool FRRMatrixFile::attach(const char* data, size_t size)
+{
+	_header = NULL;
+	_data = NULL;
+	_names.clear();
+	if (data == NULL || size < sizeof(FRRMatrixHeader)) return false;
+
+	const FRRMatrixHeader* header = (const FRRMatrixHeader*)data;
+	if (memcmp(header->magic, matrixMagic, 4) != 0 || header->version != matrixVersion) return false;
+	if (header->rows < 0 || header->cols < 0) return false;
+	if (header->type != kFloat64 && header->type != kFloat32) return false;
+	if (header->layout != kRowMajor && header->layout != kColumnMajor) return false;
+
+	// Sizes and offsets are checked as differences, so no sum of hostile values can overflow
+	const long long fileSize = (long long)size;
+	const long long count = (long long)header->rows * header->cols;
+	const long long elemSize = (header->type == kFloat64) ? sizeof(double) : sizeof(float);
+	const long long rangeEnd = sizeof(FRRMatrixHeader) + 2LL * header->cols * sizeof(double);
+	if (header->nameSize < 0 || header->dataSize < 0) return false;
+	if (header->dataOffset < rangeEnd || header->dataOffset > fileSize || header->dataOffset % FRR_MATRIX_ALIGN != 0) return false;
+	if (count > (fileSize - header->dataOffset) / elemSize || header->dataSize != count * elemSize) return false;
+	if (header->nameOffset < rangeEnd || header->nameOffset > header->dataOffset || header->nameSize > header->dataOffset - header->nameOffset) return false;
+
+	// Column names
+	const char* name = data + header->nameOffset;
+	const char* nameEnd = name + header->nameSize;
+	for (int j = 0; j < header->cols; j++)
+	{
+		const char* end = (const char*)memchr(name, '\0', nameEnd - name);
+		if (end == NULL) return false;
+		_names.push_back(std::string(name, end));
+		name = end + 1;
+	}
+
+	_header = header;
+	_colMin = (const double*)(data + sizeof(FRRMatrixHeader));
+	_colMax = _colMin + header->cols;
+	_data = data + header->dataOffset;
+	return true;
+}
+
+void FRRMatrixFile::close()
+{
+	_file.close();
+	_header = NULL;
+	_data = NULL;
+	_names.clear();
+}
+
+const double* FRRMatrixFile::data() const
+{
+	if (_header == NULL || _header->type != kFloat64 || _header->layout != kRowMajor) return NULL;
+	return (const double*)_data;
+}
+
+double FRRMatrixFile::value(int i, int j) const
+{
+	size_t index = (_header->layout == kRowMajor) ? (size_t)i * _header->cols + j : (size_t)j * _header->rows + i;
+	if (_header->type == kFloat64) return ((const double*)_data)[index];
+	return ((const float*)_data)[index];
+}
+
+// This function copies the values into values (rows x cols, row major doubles)
+void FRRMatrixFile::copyRows(double* values) const
+{
+	const int rows = this->rows(), cols = this->cols();
+	if (data() != NULL)
+	{
+		memcpy(values, _data, (size_t)rows * cols * sizeof(double));
+		return;
+	}
+#pragma omp parallel for if ((long long)rows * cols > 65536)
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++) values[(size_t)i * cols + j] = value(i, j);
+	}
+}
+
+bool FRRMatrixFile::isMatrixFileName(const char* fileName)
+{
+	size_t length = strlen(fileName), extLength = strlen(FRR_MATRIX_EXT);
+	if (length < extLength) return false;
+	const char* ext = fileName + length - extLength;
+	for (size_t i = 0; i < extLength; i++)
+	{
+		if (tolower(ext[i]) != FRR_MATRIX_EXT[i]) return false;
+	}
+	return true;
+}
+
+// This function writes values (rows x cols, row major doubles) as a binary matrix file.
+// names gives the column names (may be empty). float32 files are smaller but not lossless.
+bool FRRMatrixFile::write(const char* fileName, const double* values, int rows, int cols,
+						  const std::vector<std::string>& names, Layout layout, Type type)
+{
+	std::ofstream fout(fileName, std::ios::binary);
+	if (!fout.is_open()) return false;
+	return write(fout, values, rows, cols, names, layout, type);
+}
+
+// This function writes the binary matrix file to a stream (e.g. as a section of a bundle)
+bool FRRMatrixFile::write(std::ostream& fout, const double* values, int rows, int cols,
+						  const std::vector<std::string>& names, Layout layout, Type type)
+{
+	std::vector<double> colMin(cols, DBL_MAX), colMax(cols, -DBL_MAX);
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++)
+		{
+			double v = values[(size_t)i * cols + j];
+			if (v < colMin[j]) colMin[j] = v;
+			if (v > colMax[j]) colMax[j] = v;
+		}
+	}
+
+	std::string nameBlock;
+	for (int j = 0; j < cols; j++)
+	{
+		if (j < (int)names.size()) nameBlock += names[j];
+		nameBlock += '\0';
+	}
+
+	FRRMatrixHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, matrixMagic, 4);
+	header.version = matrixVersion;
+	header.rows = rows;
+	header.cols = cols;
+	header.type = type;
+	header.layout = layout;
+	header.nameOffset = sizeof(FRRMatrixHeader) + 2LL * cols * sizeof(double);
+	header.nameSize = nameBlock.size();
+	header.dataOffset = (header.nameOffset + header.nameSize + FRR_MATRIX_ALIGN - 1) / FRR_MATRIX_ALIGN * FRR_MATRIX_ALIGN;
+	header.dataSize = (long long)rows * cols * ((type == kFloat64) ? sizeof(double) : sizeof(float));
+
+	fout.write((const char*)&header, sizeof(header));
+	if (cols > 0)
+	{
+		fout.write((const char*)&colMin[0], cols * sizeof(double));
+		fout.write((const char*)&colMax[0], cols * sizeof(double));
+	}
+	fout.write(nameBlock.data(), nameBlock.size());
+	const char padding[FRR_MATRIX_ALIGN] = { 0 };
+	fout.write(padding, header.dataOffset - header.nameOffset - header.nameSize);
+
+	// Payload, one row (or column) at a time
+	std::vector<double> line64;
+	std::vector<float> line32;
+	const int numLine = (layout == kRowMajor) ? rows : cols;
+	const int lineSize = (layout == kRowMajor) ? cols : rows;
+	for (int l = 0; l < numLine && lineSize > 0; l++)
+	{
+		line64.resize(lineSize);
+		for (int k = 0; k < lineSize; k++)
+		{
+			line64[k] = (layout == kRowMajor) ? values[(size_t)l * cols + k] : values[(size_t)k * cols + l];
+		}
+		if (type == kFloat64)
+		{
+			fout.write((const char*)&line64[0], lineSize * sizeof(double));
+		}
+		else
+		{
+			line32.assign(line64.begin(), line64.end());
+			fout.write((const char*)&line32[0], lineSize * sizeof(float));
+		}
+	}
+	return fout.good();
+}
+
+// This function writes values as a binary matrix file if the file name ends with FRR_MATRIX_EXT,
+// as a compressed animation file (FRR_ANIM_TOLERANCE) if it ends with FRR_ANIM_EXT, and as a
+// .dat text file (with precision digits) otherwise
+bool FRRMatrixFile::save(const char* fileName, const double* values, int rows, int cols,
+						 const std::vector<std::string>& names, int precision)
+{
+	if (isMatrixFileName(fileName)) return write(fileName, values, rows, cols, names);
+	if (FRRAnimFile::isAnimFileName(fileName)) return FRRAnimFile::write(fileName, values, rows, cols, names, std::vector<double>(1, FRR_ANIM_TOLERANCE));
+	return FRRDatFile::write(fileName, values, rows, cols, precision);
+}
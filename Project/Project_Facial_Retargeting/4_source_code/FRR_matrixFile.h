@@ -0,0 +1,78 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRMATRIXFILE
+#define _FRRMATRIXFILE
+
+#include "FRR_datFile.h"
+#include <vector>
+#include <string>
+#include <ostream>
+
+#define FRR_MATRIX_EXT		".frm"	// file name extension of the binary matrix files
+#define FRR_MATRIX_ALIGN	64		// alignment of the payload in the file (bytes)
+
+// Header of a binary matrix file (64 bytes, little endian).
+// It is followed by the min and the max of each column (doubles), the column names (zero
+// terminated strings) and, at dataOffset, the payload.
+struct FRRMatrixHeader
+{
+	char		magic[4];		// "FRRM"
+	int			version;
+	int			rows;
+	int			cols;
+	int			type;			// FRRMatrixFile::Type
+	int			layout;			// FRRMatrixFile::Layout
+	long long	nameOffset;
+	long long	nameSize;
+	long long	dataOffset;		// multiple of FRR_MATRIX_ALIGN
+	long long	dataSize;
+	long long	reserved;
+};
+
+// Binary matrix file (.frm) of the pipeline data : blend weights, controller values, results.
+// The file is memory mapped and the values are read from the mapping : row major doubles (data())
+// are copied with one memcpy, the other layouts and types are converted on the way.
+// The readers (FRRDatFile, FRRDataCache) copy the values and close the file, so a cached file is
+// never kept mapped (a mapped file cannot be overwritten on Windows).
+// open() also takes a dataset of a bundle ("koko.frb:humanROE", see FRRBundle).
+class FRRMatrixFile
+{
+public:
+	enum Type { kFloat64 = 0, kFloat32 = 1 };
+	enum Layout { kRowMajor = 0, kColumnMajor = 1 };
+
+	FRRMatrixFile() : _header(NULL), _data(NULL) {}
+
+	bool	open(const char* fileName);
+	bool	attach(const char* data, size_t size);		// view of a matrix file already in memory
+	void	close();
+
+	int		rows() const					{ return _header ? _header->rows : 0; }
+	int		cols() const					{ return _header ? _header->cols : 0; }
+	Type	type() const					{ return (Type)_header->type; }
+	Layout	layout() const					{ return (Layout)_header->layout; }
+	double	colMin(int j) const				{ return _colMin[j]; }
+	double	colMax(int j) const				{ return _colMax[j]; }
+	const std::string& colName(int j) const	{ return _names[j]; }
+
+	const double*	data() const;				// mapped payload if row major doubles, NULL otherwise
+	double			value(int i, int j) const;
+	void			copyRows(double* values) const;
+
+	static bool	isMatrixFileName(const char* fileName);
+	static bool	write(const char* fileName, const double* values, int rows, int cols,
+					  const std::vector<std::string>& names, Layout layout = kRowMajor, Type type = kFloat64);
+	static bool	write(std::ostream& fout, const double* values, int rows, int cols,
+					  const std::vector<std::string>& names, Layout layout = kRowMajor, Type type = kFloat64);
+	static bool	save(const char* fileName, const double* values, int rows, int cols,
+					 const std::vector<std::string>& names, int precision = 6);
+
+private:
+	FRRMappedFile				_file;
+	const FRRMatrixHeader*		_header;
+	const double*				_colMin;
+	const double*				_colMax;
+	const char*					_data;
+	std::vector<std::string>	_names;
+};
+
+#endif
@@ -0,0 +1,198 @@
+//deformer -type frrPoseDeformer headMesh;
+//connectAttr ctrl_jaw.rotateX frrPoseDeformer1.pose[0];
+//setAttr frrPoseDeformer1.examplePose[0] -type doubleArray 1 0.5;
+//setAttr frrPoseDeformer1.exampleIndex[0] -type Int32Array 2 10 11;
+//setAttr frrPoseDeformer1.exampleDelta[0] -type pointArray 2 0 0.1 0 1 0 0.1 0 1;
+
+#include "FRR_poseDeformer.h"
+
+// For local testing of nodes you can use any identifier between
+// 0x00000000 and 0x0007ffff
+MTypeId     FRRPOSEDEFORMERNode::id(0x00000242);
+
+// Attributes
+MObject     FRRPOSEDEFORMERNode::aPose;
+MObject     FRRPOSEDEFORMERNode::aExamplePose;
+MObject     FRRPOSEDEFORMERNode::aExampleIndex;
+MObject     FRRPOSEDEFORMERNode::aExampleDelta;
+
+
+FRRPOSEDEFORMERNode::FRRPOSEDEFORMERNode()
+{
+	_rbf.setBasisFunc(rbf::BF_HARDY);
+	_rbf.setLamda(0.0);		// each shape is exactly 1 at its own pose
+}
+
+
+FRRPOSEDEFORMERNode::~FRRPOSEDEFORMERNode()
+{
+}
+
+
+void* FRRPOSEDEFORMERNode::creator()
+{
+	return new FRRPOSEDEFORMERNode();
+}
+
+
+MStatus FRRPOSEDEFORMERNode::deform(MDataBlock& data, MItGeometry& itGeo,
+	const MMatrix& localToWorldMatrix, unsigned int geomIndex)
+{
+	MStatus status;
+
+	float env = data.inputValue(envelope).asFloat();
+	if (env == 0.0) return MS::kSuccess;
+
+	MArrayDataHandle examplePoseArray = data.inputArrayValue(aExamplePose, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	unsigned int numExample = examplePoseArray.elementCount();
+	if (numExample == 0) return MS::kSuccess;
+
+	// Read the example poses (all of the same dimension)
+	std::vector<double> poses;
+	unsigned int dimPose = 0;
+	for (unsigned int i = 0; i < numExample; i++)
+	{
+		examplePoseArray.jumpToArrayElement(i);
+		MObject poseObj = examplePoseArray.inputValue().data();
+		MFnDoubleArrayData poseData(poseObj);
+		if (i == 0) {
+			dimPose = poseData.length();
+			poses.reserve(numExample * dimPose);
+		}
+		if (dimPose == 0 || poseData.length() != dimPose) return MS::kSuccess;
+		for (unsigned int k = 0; k < dimPose; k++) poses.push_back(poseData[k]);
+	}
+
+	// Train again only when the example poses changed (outputs are the identity)
+	if (poses != _cachedPoses)
+	{
+		vector<vector<double>> input(numExample), output(numExample);
+		for (unsigned int i = 0; i < numExample; i++)
+		{
+			vector<double> tempVec(dimPose);
+			std::copy(poses.begin() + i * dimPose, poses.begin() + (i + 1) * dimPose, tempVec.begin());
+			input(i) = tempVec;
+
+			tempVec.resize(numExample, false);
+			std::fill(tempVec.begin(), tempVec.end(), 0.0);
+			tempVec(i) = 1.0;
+			output(i) = tempVec;
+		}
+
+		if (_rbf.Train(input, output) != 0)
+		{
+			// e.g. two examples at the same pose
+			_cachedPoses.clear();
+			return MS::kSuccess;
+		}
+		_cachedPoses = poses;
+		_pose.assign(dimPose, 0.0);
+		_shapeWeight.assign(numExample, 0.0);
+	}
+
+	// Evaluate the small pose space rbf : pose -> shape weights
+	MArrayDataHandle poseArray = data.inputArrayValue(aPose, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	std::fill(_pose.begin(), _pose.end(), 0.0);
+	unsigned int numPose = poseArray.elementCount();
+	for (unsigned int i = 0; i < numPose; i++)
+	{
+		poseArray.jumpToArrayElement(i);
+		unsigned int index = poseArray.elementIndex();
+		if (index < dimPose) _pose[index] = poseArray.inputValue().asDouble();
+	}
+	_rbf.Interpolate(&_pose[0], &_shapeWeight[0]);
+
+	// Accumulate the sparse deltas of the active shapes.
+	// This is a plain scalar scatter-add : the vertex indices are arbitrary, so it does not vectorize.
+	MPointArray points;
+	itGeo.allPositions(points);
+	unsigned int numPoint = points.length();
+	if (numPoint == 0) return MS::kSuccess;
+
+	_offset.assign(numPoint * 3, 0.0);
+	double *offset = &_offset[0];
+
+	MArrayDataHandle indexArray = data.inputArrayValue(aExampleIndex, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	MArrayDataHandle deltaArray = data.inputArrayValue(aExampleDelta, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	for (unsigned int i = 0; i < numExample; i++)
+	{
+		const double w = _shapeWeight[i];
+		if (std::fabs(w) < 1e-6) continue;
+
+		examplePoseArray.jumpToArrayElement(i);
+		unsigned int logicalIndex = examplePoseArray.elementIndex();
+		if (!indexArray.jumpToElement(logicalIndex) || !deltaArray.jumpToElement(logicalIndex)) continue;
+
+		MObject indexObj = indexArray.inputValue().data();
+		MObject deltaObj = deltaArray.inputValue().data();
+		MFnIntArrayData indexData(indexObj);
+		MFnPointArrayData deltaData(deltaObj);
+		unsigned int numDelta = indexData.length() < deltaData.length() ? indexData.length() : deltaData.length();
+		for (unsigned int k = 0; k < numDelta; k++)
+		{
+			const unsigned int v = indexData[k];
+			if (v >= numPoint) continue;
+			const MPoint &d = deltaData[k];
+			offset[v * 3 + 0] += w * d.x;
+			offset[v * 3 + 1] += w * d.y;
+			offset[v * 3 + 2] += w * d.z;
+		}
+	}
+
+	// Apply them in object space
+	unsigned int i = 0;
+	for (itGeo.reset(); !itGeo.isDone(); itGeo.next(), i++)
+	{
+		const double *o = offset + i * 3;
+		if (o[0] == 0.0 && o[1] == 0.0 && o[2] == 0.0) continue;
+		float w = env * weightValue(data, geomIndex, itGeo.index());
+		points[i].x += w * o[0];
+		points[i].y += w * o[1];
+		points[i].z += w * o[2];
+	}
+	itGeo.setAllPositions(points);
+
+	return MS::kSuccess;
+}
+
+
+MStatus FRRPOSEDEFORMERNode::initialize()
+{
+	MFnNumericAttribute nAttr;
+	MFnTypedAttribute tAttr;
+
+	// Create attribute for the current pose
+	aPose = nAttr.create("pose", "ps", MFnNumericData::kDouble, 0.0);
+	nAttr.setArray(true);
+	nAttr.setKeyable(true);
+	addAttribute(aPose);
+	attributeAffects(aPose, outputGeom);
+
+	// Create attributes for the examples (pose and sparse corrective shape)
+	aExamplePose = tAttr.create("examplePose", "ep", MFnData::kDoubleArray);
+	tAttr.setArray(true);
+	tAttr.setUsesArrayDataBuilder(true);
+	addAttribute(aExamplePose);
+	attributeAffects(aExamplePose, outputGeom);
+
+	aExampleIndex = tAttr.create("exampleIndex", "ei", MFnData::kIntArray);
+	tAttr.setArray(true);
+	tAttr.setUsesArrayDataBuilder(true);
+	addAttribute(aExampleIndex);
+	attributeAffects(aExampleIndex, outputGeom);
+
+	aExampleDelta = tAttr.create("exampleDelta", "ed", MFnData::kPointArray);
+	tAttr.setArray(true);
+	tAttr.setUsesArrayDataBuilder(true);
+	addAttribute(aExampleDelta);
+	attributeAffects(aExampleDelta, outputGeom);
+
+	return MS::kSuccess;
+}
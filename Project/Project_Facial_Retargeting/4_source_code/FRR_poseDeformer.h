@@ -0,0 +1,51 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRPOSEDEFORMERNode
+#define _FRRPOSEDEFORMERNode
+
+#include "global.h"
+#include "rbfKernel.h"
+#include <maya/MPxDeformerNode.h>
+#include <maya/MItGeometry.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MFnTypedAttribute.h>
+#include <maya/MFnDoubleArrayData.h>
+#include <maya/MFnIntArrayData.h>
+#include <maya/MFnPointArrayData.h>
+#include <maya/MPointArray.h>
+#include <maya/MMatrix.h>
+
+// Pose space deformation : the rbf maps the pose vector (e.g. controller rotations) to the
+// weights of the sculpted corrective shapes. Example i has a pose and a corrective shape,
+// which gets weight 1 at its own pose and 0 at the others.
+// Corrective shapes are sparse : deltas (object space) of the listed vertices only.
+class FRRPOSEDEFORMERNode : public MPxDeformerNode
+{
+public:
+						FRRPOSEDEFORMERNode();
+	virtual				~FRRPOSEDEFORMERNode();
+	static  void*		creator();
+
+	virtual MStatus     deform( MDataBlock& data,
+								MItGeometry& itGeo,
+								const MMatrix& localToWorldMatrix,
+								unsigned int geomIndex);
+
+	static  MStatus		initialize();
+
+	static  MTypeId		id;
+
+	// Attributes
+	static  MObject		aPose;				// current pose vector
+	static  MObject		aExamplePose;		// pose vector of each example
+	static  MObject		aExampleIndex;		// vertex indices of each corrective shape
+	static  MObject		aExampleDelta;		// vertex deltas of each corrective shape
+
+private:
+	rbf					_rbf;				// trained on the example poses, outputs are the shape weights
+	std::vector<double>	_cachedPoses;		// example poses the rbf was trained on
+	std::vector<double>	_pose;				// current pose, sized when trained
+	std::vector<double>	_shapeWeight;		// weight of each corrective shape
+	std::vector<double>	_offset;			// accumulated delta of each vertex (xyz)
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "FRR_resultCache.h"
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static const char cacheMagic[4] = { 'F', 'R', 'R', 'C' };
+
+
+// 64-bit FNV-1a hash of the bytes, chained from seed
+unsigned long long FRRResultCache::hashBytes(const void* data, size_t size, unsigned long long seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	unsigned long long h = seed ^ 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// Hash of the rows [begin, end) including their sizes
+unsigned long long FRRResultCache::hashRows(const rbfMatrixView& rows, int begin, int end, unsigned long long seed)
+{
+	unsigned long long h = seed;
+	int dim = rows.cols;
+	for (int i = begin; i < end; i++)
+	{
+		h = hashBytes(&dim, sizeof(dim), h);
+		if (dim > 0) h = hashBytes(rows.row(i), dim * sizeof(double), h);
+	}
+	return h;
+}
+
+std::string FRRResultCache::path(unsigned long long key) const
+{
+	char name[32];
+	sprintf(name, "%016llx.frc", key);
+	if (_dir.empty()) return name;
+	char last = _dir[_dir.size() - 1];
+	if (last == '/' || last == '\\') return _dir + name;
+	return _dir + "/" + name;
+}
+
+// This function creates the cache directory if it does not exist yet (not its parents)
+bool FRRResultCache::create()
+{
+	std::string dir = _dir;
+	while (dir.size() > 1 && (dir[dir.size() - 1] == '/' || dir[dir.size() - 1] == '\\')) dir.erase(dir.size() - 1);
+	if (dir.empty()) return true;
+
+#ifdef _WIN32
+	if (_mkdir(dir.c_str()) == 0) return true;
+#else
+	if (mkdir(dir.c_str(), 0777) == 0) return true;
+#endif
+	struct stat info;
+	return errno == EEXIST && stat(dir.c_str(), &info) == 0 && (info.st_mode & S_IFDIR) != 0;
+}
+
+// This function reads a cached chunk of numRows x cols values straight into result (row major).
+// Chunk file : magic, rows, columns, then the values row by row (binary)
+bool FRRResultCache::load(unsigned long long key, double* result, int numRows, int cols)
+{
+	std::ifstream fin(path(key).c_str(), std::ios::binary);
+	char magic[4];
+	int rows = 0, fileCols = 0;
+	if (fin.read(magic, 4) && fin.read((char*)&rows, sizeof(rows)) && fin.read((char*)&fileCols, sizeof(fileCols))
+		&& std::equal(magic, magic + 4, cacheMagic) && rows == numRows && fileCols == cols && cols > 0
+		&& fin.read((char*)result, (size_t)rows * cols * sizeof(double)))
+	{
+		_hits++;
+		return true;
+	}
+	_misses++;
+	return false;
+}
+
+// This function writes the numRows x cols values of result (row major) as the chunk of key.
+// The chunk goes to a temporary file unique to this process and store call, then is renamed.
+bool FRRResultCache::store(unsigned long long key, const double* result, int numRows, int cols)
+{
+	if (numRows <= 0 || cols <= 0) return false;
+
+	static std::atomic<unsigned int> numStore(0);
+	std::string fileName = path(key);
+	char suffix[32];
+	sprintf(suffix, ".%d.%u.tmp", (int)getpid(), numStore++);
+	std::string tempName = fileName + suffix;
+
+	bool ok;
+	{
+		std::ofstream fout(tempName.c_str(), std::ios::binary | std::ios::trunc);
+		if (fout) {
+			fout.write(cacheMagic, 4);
+			fout.write((const char*)&numRows, sizeof(numRows));
+			fout.write((const char*)&cols, sizeof(cols));
+			fout.write((const char*)result, (size_t)numRows * cols * sizeof(double));
+			fout.close();
+		}
+		ok = !fout.fail();
+	}
+	if (ok)
+	{
+		// Another session may have stored the same chunk meanwhile, its content is the same
+		remove(fileName.c_str());
+		ok = (rename(tempName.c_str(), fileName.c_str()) == 0);
+	}
+	if (ok) return true;
+	remove(tempName.c_str());
+	_failures++;
+	return false;
+}
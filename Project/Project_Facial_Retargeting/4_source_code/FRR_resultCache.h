@@ -0,0 +1,43 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRRESULTCACHE
+#define _FRRRESULTCACHE
+
+#include "rbfKernel.h"
+#include <string>
+
+#define FRR_CACHE_CHUNK		64		// number of source frames per cached result chunk
+#define FRR_CACHE_VERSION	1		// seed of every key : bump it when the rbf kernel or the chunk format changes
+
+// On-disk cache of retargeting results, addressed by content.
+// A chunk key is the hash of the model (ROE data and training options) and of the source
+// frames of the chunk, so unchanged chunks are found again across runs and edits.
+// With adaptive interpolation the placement of the evaluated frames depends on the chunk
+// boundaries, so the whole sequence is cached as one chunk (same result as without the cache).
+// A chunk is written to a temporary file and renamed into place, so concurrent sessions
+// storing the same key, or a crash in the middle of a write, never leave a partial chunk.
+class FRRResultCache
+{
+public:
+	FRRResultCache(const std::string& dir) : _dir(dir), _hits(0), _misses(0), _failures(0) {}
+
+	static unsigned long long hashBytes(const void* data, size_t size, unsigned long long seed);
+	static unsigned long long hashRows(const rbfMatrixView& rows, int begin, int end, unsigned long long seed);
+
+	bool create();
+	bool load(unsigned long long key, double* result, int numRows, int cols);
+	bool store(unsigned long long key, const double* result, int numRows, int cols);
+
+	int hits() const { return _hits; }
+	int misses() const { return _misses; }
+	int failures() const { return _failures; }
+
+private:
+	std::string path(unsigned long long key) const;
+
+	std::string _dir;
+	int _hits;
+	int _misses;
+	int _failures;
+};
+
+#endif
@@ -0,0 +1,340 @@
+//FRRRetarget -rbn "targetBlend" -rs 1001 -rf 36 -bn "targetBlend" -f 360 -cln "kokoCtrlList.dat"
+//FRRRetarget -rbn "targetBlend" -rs 1001 -rf 36 -bn "targetBlend" -f 360 -cln "kokoCtrlList.dat" -ffn "kokoFinalResult.dat"
+//
+// The ROE poses are read from frames roeStart ~ roeStart+roeFrames-1 of the ROE blendshape node and the controllers,
+// the source animation from frames 1 ~ frame of the blendshape node. The result is keyed on the controllers at frames 1 ~ frame.
+
+#include "FRR_retarget.h"
+#include "FRR_dataCache.h"
+#include "FRR_matrixFile.h"
+#include <maya/MDGContext.h>
+#include <maya/MTime.h>
+#include <maya/MPlugArray.h>
+
+const char *retargetRoeBlendNodeFlag = "-rbn", *retargetRoeBlendNodeLongFlag = "-roeBlendNodeName";
+const char *retargetRoeStartFlag = "-rs", *retargetRoeStartLongFlag = "-roeStart";
+const char *retargetRoeFramesFlag = "-rf", *retargetRoeFramesLongFlag = "-roeFrames";
+const char *retargetBlendNodeFlag = "-bn", *retargetBlendNodeLongFlag = "-blendNodeName";
+const char *retargetFrameFlag = "-f", *retargetFrameLongFlag = "-frame";
+const char *retargetCtrlListFlag = "-cln", *retargetCtrlListLongFlag = "-ctrlListFileName";
+const char *retargetBlendFileFlag = "-bfn", *retargetBlendFileLongFlag = "-blendFileName";
+const char *retargetCVFileFlag = "-cfn", *retargetCVFileLongFlag = "-cvFileName";
+const char *retargetSourceFileFlag = "-sfn", *retargetSourceFileLongFlag = "-sourceFileName";
+const char *retargetFinalFileFlag = "-ffn", *retargetFinalFileLongFlag = "-finalFileName";
+
+MSyntax FRRRETARGETCmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(retargetRoeBlendNodeFlag, retargetRoeBlendNodeLongFlag, MSyntax::kString);
+	syntax.addFlag(retargetRoeStartFlag, retargetRoeStartLongFlag, MSyntax::kLong);
+	syntax.addFlag(retargetRoeFramesFlag, retargetRoeFramesLongFlag, MSyntax::kLong);
+	syntax.addFlag(retargetBlendNodeFlag, retargetBlendNodeLongFlag, MSyntax::kString);
+	syntax.addFlag(retargetFrameFlag, retargetFrameLongFlag, MSyntax::kLong);
+	syntax.addFlag(retargetCtrlListFlag, retargetCtrlListLongFlag, MSyntax::kString);
+
+	// Optional debug outputs, same files as the step by step workflow
+	syntax.addFlag(retargetBlendFileFlag, retargetBlendFileLongFlag, MSyntax::kString);
+	syntax.addFlag(retargetCVFileFlag, retargetCVFileLongFlag, MSyntax::kString);
+	syntax.addFlag(retargetSourceFileFlag, retargetSourceFileLongFlag, MSyntax::kString);
+	syntax.addFlag(retargetFinalFileFlag, retargetFinalFileLongFlag, MSyntax::kString);
+	return syntax;
+}
+
+MStatus FRRRETARGETCmd::doIt(const MArgList &args)
+{
+	MString roeBlendNodeName;
+	MString blendNodeName;
+	MString ctrlListFileName;
+	MString blendFile, CVFile, sourceFile, finalFile;
+	int roeStart = 1;
+	int roeFrames = 0;
+	int frameNum = 0;
+
+	MArgDatabase argData(syntax(), args);
+	if (argData.isFlagSet(retargetBlendNodeFlag))
+		argData.getFlagArgument(retargetBlendNodeFlag, 0, blendNodeName);
+	roeBlendNodeName = blendNodeName;
+	if (argData.isFlagSet(retargetRoeBlendNodeFlag))
+		argData.getFlagArgument(retargetRoeBlendNodeFlag, 0, roeBlendNodeName);
+	if (argData.isFlagSet(retargetRoeStartFlag))
+		argData.getFlagArgument(retargetRoeStartFlag, 0, roeStart);
+	if (argData.isFlagSet(retargetRoeFramesFlag))
+		argData.getFlagArgument(retargetRoeFramesFlag, 0, roeFrames);
+	if (argData.isFlagSet(retargetFrameFlag))
+		argData.getFlagArgument(retargetFrameFlag, 0, frameNum);
+	if (argData.isFlagSet(retargetCtrlListFlag))
+		argData.getFlagArgument(retargetCtrlListFlag, 0, ctrlListFileName);
+	if (argData.isFlagSet(retargetBlendFileFlag))
+		argData.getFlagArgument(retargetBlendFileFlag, 0, blendFile);
+	if (argData.isFlagSet(retargetCVFileFlag))
+		argData.getFlagArgument(retargetCVFileFlag, 0, CVFile);
+	if (argData.isFlagSet(retargetSourceFileFlag))
+		argData.getFlagArgument(retargetSourceFileFlag, 0, sourceFile);
+	if (argData.isFlagSet(retargetFinalFileFlag))
+		argData.getFlagArgument(retargetFinalFileFlag, 0, finalFile);
+
+	MStatus stat;
+	if (roeFrames <= 0 || frameNum <= 0) {
+		stat = MS::kInvalidParameter;
+		stat.perror("FRRRetarget needs -roeFrames and -frame!");
+		return stat;
+	}
+
+	// Resolve the controller plugs once
+	MStringArray ctrlListArr;
+	stat = readCtrlList(ctrlListFileName, ctrlListArr);
+	if (!stat) {
+		stat.perror("Cannot read the controller list " + ctrlListFileName);
+		return stat;
+	}
+	std::vector<MPlug> ctrlPlugs;
+	std::vector<std::string> ctrlNames, weightNames, sourceNames;
+	stat = findCtrlPlugs(ctrlListArr, ctrlPlugs, &ctrlNames);
+	if (!stat) {
+		stat.perror("Cannot find the controllers of " + ctrlListFileName);
+		return stat;
+	}
+	int cartoonFaceDim = ctrlPlugs.size();
+
+	// Sample the ROE data (humanROE.dat, kokoROE.dat)
+	std::vector<double> humanROE, cartoonROE;
+	int humanFaceDim = 0;
+	stat = sampleBlendWeights(roeBlendNodeName, roeStart, roeFrames, humanROE, humanFaceDim, &weightNames);
+	if (!stat) {
+		stat.perror("Cannot find the blendshape node " + roeBlendNodeName);
+		return stat;
+	}
+	samplePlugs(ctrlPlugs, roeStart, roeFrames, cartoonROE);
+
+	// Sample the source animation (humanSourceAnimation.dat)
+	std::vector<double> source;
+	int sourceDim = 0;
+	stat = sampleBlendWeights(blendNodeName, 1, frameNum, source, sourceDim, &sourceNames);
+	if (!stat) {
+		stat.perror("Cannot find the blendshape node " + blendNodeName);
+		return stat;
+	}
+	if (sourceDim != humanFaceDim || humanFaceDim == 0 || cartoonFaceDim == 0) {
+		stat = MS::kFailure;
+		stat.perror("Data Pair Size is different!");
+		return stat;
+	}
+
+	if (blendFile.length() > 0) writeRows(humanROE, humanFaceDim, blendFile, weightNames);
+	if (CVFile.length() > 0) writeRows(cartoonROE, cartoonFaceDim, CVFile, ctrlNames);
+	if (sourceFile.length() > 0) writeRows(source, sourceDim, sourceFile, sourceNames);
+
+
+	// Train RBF network (same settings as FRRTraining) on the sampled rows in place
+	rbfMatrixView input(&humanROE[0], roeFrames, humanFaceDim);
+	rbfMatrixView output(&cartoonROE[0], roeFrames, cartoonFaceDim);
+
+	rbf rbfn;
+	rbfn.setBasisFunc(rbf::BF_HARDY);
+	rbfn.setLamda(0.1);
+	if (rbfn.Train(input, output) != 0) {
+		stat = MS::kFailure;
+		stat.perror("Training failed!");
+		return stat;
+	}
+
+	// Run RBF interpolation on all frames at once
+	std::vector<double> result(frameNum * cartoonFaceDim);
+	rbfn.InterpolateBatch(&source[0], frameNum, &result[0]);
+
+	if (finalFile.length() > 0) writeRows(result, cartoonFaceDim, finalFile, ctrlNames);
+
+
+	// Key the controllers, one anim curve at a time
+	int numSkipped = 0;
+	for (int j = 0; j < cartoonFaceDim; j++)
+	{
+		MFnAnimCurve curve(ctrlPlugs[j], &stat);
+		if (!stat) {
+			// Driven by something else than an anim curve
+			numSkipped++;
+			continue;
+		}
+		for (int i = 0; i < frameNum; i++)
+		{
+			MTime frameTime((double)(i + 1), MTime::uiUnit());
+			double value = result[i * cartoonFaceDim + j];
+			unsigned int keyIndex;
+			if (curve.find(frameTime, keyIndex))
+				curve.setValue(keyIndex, value, &animChange);
+			else
+				curve.addKey(frameTime, value, MFnAnimCurve::kTangentGlobal, MFnAnimCurve::kTangentGlobal, &animChange);
+		}
+	}
+	if (numSkipped > 0)
+	{
+		MString info("FRRRetarget: ");
+		info += numSkipped;
+		info += " attributes are not driven by an anim curve and were not keyed";
+		MGlobal::displayWarning(info);
+	}
+
+	return dgMod.doIt();
+}
+
+MStatus FRRRETARGETCmd::undoIt()
+{
+	animChange.undoIt();
+	return dgMod.undoIt();
+}
+
+MStatus FRRRETARGETCmd::redoIt()
+{
+	MStatus stat = dgMod.doIt();
+	animChange.redoIt();
+	return stat;
+}
+
+
+
+//other functions
+
+// This function reads the controller names of the ctrl list file (FRRCtrlListExport)
+MStatus FRRRETARGETCmd::readCtrlList(const MString& fileName, MStringArray& ctrlList)
+{
+	FRRDataCache::WordList words = FRRDataCache::wordList(fileName.asChar());
+	if (!words) return MS::kNotFound;
+
+	for (size_t i = 0; i < words->size(); i++) ctrlList.append((*words)[i].c_str());
+	return MS::kSuccess;
+}
+
+// This function finds the animated transform plugs of the controllers, in the column order of the ROE data.
+// Since all joints do not have all attributes (because of DoF), only the connected plugs are used.
+// names (optional) receives the column names ("controller.attribute").
+MStatus FRRRETARGETCmd::findCtrlPlugs(const MStringArray& ctrlList, std::vector<MPlug>& plugs, std::vector<std::string>* names)
+{
+	static const char* attrNames[] = { "translateX", "translateY", "translateZ", "rotateX", "rotateY", "rotateZ" };
+
+	for (unsigned int j = 0; j < ctrlList.length(); j++)
+	{
+		MSelectionList selected;
+		MObject ctrlNode;
+		if (!selected.add(ctrlList[j]) || !selected.getDependNode(0, ctrlNode)) return MS::kNotFound;
+
+		MFnTransform ctrlTransform(ctrlNode);
+		for (int k = 0; k < 6; k++)
+		{
+			MPlug plug = ctrlTransform.findPlug(attrNames[k]);
+			if (!plug.isConnected()) continue;
+			plugs.push_back(plug);
+			if (names) names->push_back(std::string(ctrlList[j].asChar()) + "." + attrNames[k]);
+		}
+	}
+	return MS::kSuccess;
+}
+
+// This function appends the weight plugs of the blendshape node to plugs, in the order of the weight indices.
+// names (optional) receives the weight names (aliases of the weight plugs).
+MStatus FRRRETARGETCmd::findBlendWeightPlugs(const MString& blendNodeName, std::vector<MPlug>& plugs, std::vector<std::string>* names)
+{
+	MSelectionList selected;
+	MObject blendNode;
+	if (!selected.add(blendNodeName) || !selected.getDependNode(0, blendNode) || !blendNode.hasFn(MFn::kBlendShape)) return MS::kNotFound;
+
+	MFnBlendShapeDeformer bnDeformer(blendNode);
+	MIntArray weightIndex;
+	bnDeformer.weightIndexList(weightIndex);
+	MPlug weightArrayPlug = bnDeformer.findPlug("weight");
+	for (unsigned int j = 0; j < weightIndex.length(); j++)
+	{
+		MPlug plug = weightArrayPlug.elementByLogicalIndex(weightIndex[j]);
+		plugs.push_back(plug);
+		if (names) names->push_back(plug.partialName(false, false, false, true).asChar());
+	}
+	return MS::kSuccess;
+}
+
+// This function samples the weights of the blendshape node at frames firstFrame ~ firstFrame+numFrames-1
+// into data (numFrames x dim, row-major), without changing the current frame.
+// names (optional) receives the weight names.
+MStatus FRRRETARGETCmd::sampleBlendWeights(const MString& blendNodeName, int firstFrame, int numFrames, std::vector<double>& data, int& dim, std::vector<std::string>* names)
+{
+	std::vector<MPlug> plugs;
+	MStatus stat = findBlendWeightPlugs(blendNodeName, plugs, names);
+	if (!stat) return stat;
+
+	dim = plugs.size();
+	samplePlugs(plugs, firstFrame, numFrames, data);
+	return MS::kSuccess;
+}
+
+// This function finds the anim curve driving the plug, if the value of the plug is the value of the curve
+// at the current time (a time input curve connected directly, not a driven key, expression or anim layer).
+static bool findTimeCurve(const MPlug& plug, MObject& curve)
+{
+	MPlugArray sources;
+	if (!plug.connectedTo(sources, true, false) || sources.length() != 1) return false;
+	curve = sources[0].node();
+	if (!curve.hasFn(MFn::kAnimCurve)) return false;
+
+	MFnAnimCurve fnCurve(curve);
+	if (!fnCurve.isTimeInput()) return false;
+
+	// The input of the curve is the current time unless something else (e.g. a time warp) is connected
+	MPlug inputPlug = fnCurve.findPlug("input");
+	if (inputPlug.connectedTo(sources, true, false) && sources.length() > 0 && !sources[0].node().hasFn(MFn::kTime)) return false;
+	return true;
+}
+
+// This function evaluates the plugs at frames firstFrame ~ firstFrame+numFrames-1
+// into data (numFrames x plugs.size(), row-major), without changing the current frame.
+// The plugs driven by an anim curve are sampled from their curves, the others (driven keys,
+// expressions, ...) are evaluated in a DG context at each frame. All Maya calls stay on the
+// calling thread : the API is not guaranteed thread safe.
+// Returns the number of plugs sampled from their curves.
+int FRRRETARGETCmd::samplePlugs(std::vector<MPlug>& plugs, int firstFrame, int numFrames, std::vector<double>& data)
+{
+	int dim = plugs.size();
+	data.resize(numFrames * dim);
+
+	std::vector<MObject> curves(dim);
+	std::vector<int> curvePlugs, otherPlugs;
+	for (int j = 0; j < dim; j++)
+	{
+		if (findTimeCurve(plugs[j], curves[j])) curvePlugs.push_back(j);
+		else otherPlugs.push_back(j);
+	}
+
+	// Anim curves : only the curve is evaluated, not the graph
+	MTime::Unit unit = MTime::uiUnit();
+	int numCurves = curvePlugs.size();
+	for (int c = 0; c < numCurves; c++)
+	{
+		int j = curvePlugs[c];
+		MFnAnimCurve curve(curves[j]);
+		for (int i = 0; i < numFrames; i++)
+		{
+			double value = 0.0;
+			curve.evaluate(MTime((double)(firstFrame + i), unit), value);
+			data[i * dim + j] = value;
+		}
+	}
+
+	// Other plugs : evaluate the graph at each frame
+	if (!otherPlugs.empty())
+	{
+		for (int i = 0; i < numFrames; i++)
+		{
+			MDGContext context(MTime((double)(firstFrame + i), unit));
+			for (unsigned int k = 0; k < otherPlugs.size(); k++)
+				data[i * dim + otherPlugs[k]] = plugs[otherPlugs[k]].asDouble(context);
+		}
+	}
+	return numCurves;
+}
+
+// This function writes data (rows of dim values) in the format of the other commands : .frm or .fra
+// with the column names by the extension of the file name, the .dat text otherwise (FRRMatrixFile::save)
+bool FRRRETARGETCmd::writeRows(const std::vector<double>& data, int dim, const MString& fileName, const std::vector<std::string>& names)
+{
+	int numRows = (dim > 0) ? data.size() / dim : 0;
+	if (FRRMatrixFile::save(fileName.asChar(), data.empty() ? NULL : &data[0], numRows, dim, names)) return true;
+	MGlobal::displayWarning("FRRRetarget: cannot write " + fileName);
+	return false;
+}
@@ -0,0 +1,38 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRRETARGETCmd
+#define _FRRRETARGETCmd
+
+#include "global.h"
+#include "rbfKernel.h"
+#include <iostream>
+#include <maya/MPlug.h>
+#include <maya/MFnAnimCurve.h>
+#include <maya/MAnimCurveChange.h>
+
+// FRRBlendExport + FRRCVExport + FRRTraining + FRRCVImport in one command.
+// The data is sampled from the scene and passed on in memory, data files (.dat, .frm or .fra) are only
+// written on request.
+class FRRRETARGETCmd : public MPxCommand
+{
+public:
+	virtual MStatus	doIt(const MArgList&);
+	virtual MStatus undoIt();
+	virtual MStatus redoIt();
+	virtual bool isUndoable() const { return true; }
+
+	static void *creator() { return new FRRRETARGETCmd; }
+	static MSyntax newSyntax();
+
+	static MStatus readCtrlList(const MString& fileName, MStringArray& ctrlList);
+	static MStatus findCtrlPlugs(const MStringArray& ctrlList, std::vector<MPlug>& plugs, std::vector<std::string>* names = NULL);
+	static MStatus findBlendWeightPlugs(const MString& blendNodeName, std::vector<MPlug>& plugs, std::vector<std::string>* names = NULL);
+	static MStatus sampleBlendWeights(const MString& blendNodeName, int firstFrame, int numFrames, std::vector<double>& data, int& dim, std::vector<std::string>* names = NULL);
+	static int samplePlugs(std::vector<MPlug>& plugs, int firstFrame, int numFrames, std::vector<double>& data);
+	static bool writeRows(const std::vector<double>& data, int dim, const MString& fileName, const std::vector<std::string>& names);
+
+private:
+	MDGModifier dgMod;
+	MAnimCurveChange animChange;	// keys set by the command (for undo)
+};
+
+#endif
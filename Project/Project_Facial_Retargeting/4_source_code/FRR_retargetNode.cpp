@@ -0,0 +1,165 @@
+//createNode frrRetargetNode;
+//setAttr -type "string" frrRetargetNode1.blendFileName "humanROE.dat";
+//setAttr -type "string" frrRetargetNode1.cvFileName "kokoROE.dat";
+//connectAttr targetBlend.weight[0] frrRetargetNode1.weight[0];
+//connectAttr frrRetargetNode1.output[0] ctrl_mouth.translateX;
+//setAttr frrRetargetNode1.reload (`getAttr frrRetargetNode1.reload` + 1);	// after editing the ROE files
+
+#include "FRR_retargetNode.h"
+#include "FRR_Training.h"
+
+// For local testing of nodes you can use any identifier between
+// 0x00000000 and 0x0007ffff
+MTypeId     FRRRETARGETNode::id(0x00000241);
+
+// Attributes
+MObject     FRRRETARGETNode::aBlendFile;
+MObject     FRRRETARGETNode::aCVFile;
+MObject     FRRRETARGETNode::aReload;
+MObject     FRRRETARGETNode::aWeight;
+MObject     FRRRETARGETNode::aOutput;
+
+
+FRRRETARGETNode::FRRRETARGETNode() : _trained(false), _cachedReload(0)
+{
+	_rbf.setBasisFunc(rbf::BF_HARDY);
+	_rbf.setLamda(0.1);		// same as FRRTraining
+}
+
+
+FRRRETARGETNode::~FRRRETARGETNode()
+{
+}
+
+
+void* FRRRETARGETNode::creator()
+{
+	return new FRRRETARGETNode();
+}
+
+
+// This function trains the rbf from the ROE data files (same data as FRRTraining -bfn -cfn)
+bool FRRRETARGETNode::trainModel(const MString& blendFile, const MString& cvFile)
+{
+	_trained = false;
+	_cachedBlendFile = blendFile;
+	_cachedCVFile = cvFile;
+
+	if (!FRRTRAININGCmd::trainFromFiles(_rbf, blendFile, cvFile)) return false;
+
+	_sample.assign(_rbf._dimInput, 0.0);
+	_result.assign(_rbf._dimOutput, 0.0);
+	_trained = true;
+	return true;
+}
+
+
+MStatus FRRRETARGETNode::compute(const MPlug& plug, MDataBlock& data)
+{
+	MStatus status;
+
+	MPlug outPlug = plug.isElement() ? plug.array() : plug;
+	if (outPlug != aOutput) return MS::kUnknownParameter;
+
+	MString blendFile = data.inputValue(aBlendFile, &status).asString();
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	MString cvFile = data.inputValue(aCVFile, &status).asString();
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	int reload = data.inputValue(aReload, &status).asInt();
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	MArrayDataHandle weightArray = data.inputArrayValue(aWeight, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	MArrayDataHandle outArray = data.outputArrayValue(aOutput, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	std::lock_guard<std::mutex> lock(_lock);
+
+	// Train again only when the ROE file names or reload changed, so that evaluations do not touch
+	// the file system (the data cache reads an edited file again when reload is bumped).
+	// Until they can be read the outputs stay at 0 (no messages, compute may run off the main thread).
+	if (blendFile != _cachedBlendFile || cvFile != _cachedCVFile || reload != _cachedReload)
+	{
+		trainModel(blendFile, cvFile);
+		_cachedReload = reload;
+	}
+	if (!_trained)
+	{
+		outArray.setAllClean();
+		return MS::kSuccess;
+	}
+
+	// Weights are placed by their logical index, unconnected ones are 0
+	std::fill(_sample.begin(), _sample.end(), 0.0);
+	unsigned int numWeight = weightArray.elementCount();
+	for (unsigned int i = 0; i < numWeight; i++)
+	{
+		weightArray.jumpToArrayElement(i);
+		unsigned int index = weightArray.elementIndex();
+		if (index < _sample.size()) _sample[index] = weightArray.inputValue().asDouble();
+	}
+
+	_rbf.Interpolate(&_sample[0], &_result[0]);
+
+	// The output elements are created once, later evaluations only write the values
+	unsigned int numOutput = _result.size();
+	if (outArray.elementCount() != numOutput)
+	{
+		MArrayDataBuilder builder(&data, aOutput, numOutput, &status);
+		CHECK_MSTATUS_AND_RETURN_IT(status);
+		for (unsigned int k = 0; k < numOutput; k++)
+			builder.addElement(k).setDouble(_result[k]);
+		outArray.set(builder);
+	}
+	else
+	{
+		for (unsigned int k = 0; k < numOutput; k++)
+		{
+			outArray.jumpToArrayElement(k);
+			outArray.outputValue().setDouble(_result[k]);
+		}
+	}
+	outArray.setAllClean();
+
+	return MS::kSuccess;
+}
+
+
+MStatus FRRRETARGETNode::initialize()
+{
+	MFnTypedAttribute tAttr;
+	MFnNumericAttribute nAttr;
+
+	// Create attributes for the ROE data files
+	aBlendFile = tAttr.create("blendFileName", "bfn", MFnData::kString);
+	addAttribute(aBlendFile);
+
+	aCVFile = tAttr.create("cvFileName", "cfn", MFnData::kString);
+	addAttribute(aCVFile);
+
+	// Create attribute to train again from the same files
+	aReload = nAttr.create("reload", "rl", MFnNumericData::kInt, 0);
+	addAttribute(aReload);
+
+	// Create attribute for the source blendshape weights
+	aWeight = nAttr.create("weight", "w", MFnNumericData::kDouble, 0.0);
+	nAttr.setArray(true);
+	nAttr.setKeyable(true);
+	addAttribute(aWeight);
+
+	// Create attribute for the controller values
+	aOutput = nAttr.create("output", "o", MFnNumericData::kDouble, 0.0);
+	nAttr.setArray(true);
+	nAttr.setUsesArrayDataBuilder(true);
+	nAttr.setWritable(false);
+	nAttr.setStorable(false);
+	addAttribute(aOutput);
+
+	attributeAffects(aBlendFile, aOutput);
+	attributeAffects(aCVFile, aOutput);
+	attributeAffects(aReload, aOutput);
+	attributeAffects(aWeight, aOutput);
+
+	return MS::kSuccess;
+}
@@ -0,0 +1,50 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRRETARGETNode
+#define _FRRRETARGETNode
+
+#include "global.h"
+#include "rbfKernel.h"
+#include <maya/MPxNode.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MFnTypedAttribute.h>
+#include <maya/MArrayDataBuilder.h>
+#include <mutex>
+
+// Live retargeting : the rbf trained on the ROE data maps the blendshape weights of the
+// source face to the controller values of the target face on every evaluation, so the
+// controllers follow the source without exporting and keying the animation.
+class FRRRETARGETNode : public MPxNode
+{
+public:
+						FRRRETARGETNode();
+	virtual				~FRRRETARGETNode();
+	static  void*		creator();
+
+	virtual MStatus		compute(const MPlug& plug, MDataBlock& data);
+	virtual SchedulingType schedulingType() const { return kParallel; }
+
+	static  MStatus		initialize();
+
+	static  MTypeId		id;
+
+	// Attributes
+	static  MObject		aBlendFile;		// source ROE data (FRRBlendExport)
+	static  MObject		aCVFile;		// target ROE data (FRRCVExport)
+	static  MObject		aReload;		// change it to train again after the ROE files were edited in place
+	static  MObject		aWeight;		// source blendshape weights, e.g. targetBlend.weight[i]
+	static  MObject		aOutput;		// controller values, in the order of the ctrl list
+
+private:
+	bool				trainModel(const MString& blendFile, const MString& cvFile);
+
+	std::mutex			_lock;			// guards the model and the buffers below
+	rbf					_rbf;
+	bool				_trained;
+	MString				_cachedBlendFile;	// ROE files the rbf was trained on
+	MString				_cachedCVFile;
+	int					_cachedReload;		// reload value the rbf was trained at
+	std::vector<double>	_sample;		// one input sample, sized when trained
+	std::vector<double>	_result;		// one output sample, sized when trained
+};
+
+#endif
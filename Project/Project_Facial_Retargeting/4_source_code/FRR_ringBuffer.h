@@ -0,0 +1,65 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRRINGBUFFER
+#define _FRRRINGBUFFER
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+// Lock-free single producer / single consumer ring of fixed size frames.
+// Each slot holds frameSize values of T. push() is called by one thread and pop() by one other
+// thread only; neither blocks, push() fails when the ring is full and pop() when it is empty.
+template<class T>
+class FRRRingBuffer
+{
+public:
+	FRRRingBuffer(unsigned int capacity, unsigned int frameSize)
+		: _frameSize(frameSize), _head(0), _tail(0)
+	{
+		// Capacity is rounded up to a power of two, so indices wrap with a mask
+		_capacity = 1;
+		while (_capacity < capacity) _capacity <<= 1;
+		_mask = _capacity - 1;
+		_data.resize(_capacity * _frameSize);
+	}
+
+	// Producer : copy one frame in, false when the ring is full (the frame is dropped)
+	bool push(const T* frame)
+	{
+		const unsigned int head = _head.load(std::memory_order_relaxed);
+		if (head - _tail.load(std::memory_order_acquire) == _capacity) return false;
+		std::copy(frame, frame + _frameSize, &_data[(head & _mask) * _frameSize]);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer : copy the oldest frame out, false when the ring is empty
+	bool pop(T* frame)
+	{
+		const unsigned int tail = _tail.load(std::memory_order_relaxed);
+		if (_head.load(std::memory_order_acquire) == tail) return false;
+		const T* slot = &_data[(tail & _mask) * _frameSize];
+		std::copy(slot, slot + _frameSize, frame);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	unsigned int size() const		{ return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+	unsigned int capacity() const	{ return _capacity; }
+	unsigned int frameSize() const	{ return _frameSize; }
+
+private:
+	unsigned int		_capacity;
+	unsigned int		_mask;
+	unsigned int		_frameSize;
+	std::vector<T>		_data;
+
+	// Written by different threads, kept on different cache lines
+	char						_pad0[64];
+	std::atomic<unsigned int>	_head;		// next slot to write (producer)
+	char						_pad1[64];
+	std::atomic<unsigned int>	_tail;		// next slot to read (consumer)
+	char						_pad2[64];
+};
+
+#endif
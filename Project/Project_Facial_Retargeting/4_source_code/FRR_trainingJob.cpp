@@ -0,0 +1,597 @@
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -async
+//FRRTrainingJob -progress
+//FRRTrainingJob -wait
+//FRRTraining -bfn "humanROE.dat" -cfn "kokoROE.dat" -sfn "humanSourceAnimation.dat" -ffn "kokoFinalResult.dat" -pl
+
+#include "FRR_trainingJob.h"
+#include "FRR_Training.h"
+#include "FRR_resultCache.h"
+#include "FRR_matrixFile.h"
+#include "FRR_animFile.h"
+#include "FRR_datFile.h"
+#include "FRR_bundle.h"
+#include <maya/MComputation.h>
+#include <chrono>
+#include <future>
+#include <condition_variable>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Writes the result rows to a .dat file on its own thread, while the next chunks are still
+// interpolated (FRRTraining -pipeline). push() hands over the rows which are final.
+// The rows go to a temporary file (fileName.part), which replaces fileName only when the whole
+// result was written, so a cancelled or failed job leaves no truncated result behind.
+class FRRResultWriter
+{
+public:
+	FRRResultWriter(const std::vector<double>& result, int cols)
+		: busyTime(0.0), _result(result), _cols(cols), _file(NULL), _ready(0), _done(false), _ok(true) {}
+	~FRRResultWriter()	{ finish(false); }
+
+	bool open(const char* fileName)
+	{
+		_fileName = fileName;
+		_file = fopen((_fileName + ".part").c_str(), "w");
+		if (_file == NULL) return false;
+		_worker = std::thread(&FRRResultWriter::run, this);
+		return true;
+	}
+
+	// Rows [0, end) of the result are final
+	void push(int end)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_ready = end;
+		_wake.notify_one();
+	}
+
+	// This function waits for the rows pushed so far and closes the file,
+	// then moves it to fileName (keep) or deletes it
+	bool finish(bool keep = true)
+	{
+		if (_worker.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_done = true;
+			}
+			_wake.notify_one();
+			_worker.join();
+		}
+		if (_file != NULL)
+		{
+			if (fclose(_file) != 0) _ok = false;
+			_file = NULL;
+
+			std::string tempName = _fileName + ".part";
+			if (keep && _ok)
+			{
+				remove(_fileName.c_str());
+				if (rename(tempName.c_str(), _fileName.c_str()) != 0) _ok = false;
+			}
+			if (!keep || !_ok) remove(tempName.c_str());
+		}
+		return _ok;
+	}
+
+	double	busyTime;		// seconds spent formatting and writing
+
+private:
+	void run()
+	{
+		int written = 0;
+		std::vector<const double*> rows;
+		while (true)
+		{
+			int ready;
+			{
+				std::unique_lock<std::mutex> lock(_lock);
+				while (_ready == written && !_done) _wake.wait(lock);
+				ready = _ready;
+			}
+			if (ready == written) return;
+
+			Clock::time_point start = Clock::now();
+			rows.resize(ready - written);
+			for (int i = written; i < ready; i++) rows[i - written] = &_result[(size_t)i * _cols];
+			if (!FRRDatFile::write(_file, &rows[0], ready - written, _cols)) _ok = false;
+			written = ready;
+			busyTime += secondsSince(start);
+		}
+	}
+
+	const std::vector<double>&		_result;
+	int								_cols;
+	std::string						_fileName;
+	FILE*							_file;
+	std::thread						_worker;
+	std::mutex						_lock;
+	std::condition_variable			_wake;
+	int								_ready;
+	bool							_done;
+	bool							_ok;
+};
+
+FRRTrainingJob* FRRTrainingJob::background = NULL;
+
+FRRTrainingJob::FRRTrainingJob()
+	: maxCenters(0), tolerance(0.0), greedy(false), adaptiveTolerance(-1.0), lowMemory(false), pruneThreshold(0.0), pipeline(false),
+	  _state(kIdle), _progress(0), _cancel(false)
+{
+}
+
+FRRTrainingJob::~FRRTrainingJob()
+{
+	cancel();
+	wait();
+}
+
+void FRRTrainingJob::start()
+{
+	wait();
+	_state = kRunning;
+	_cancel = false;
+	_worker = std::thread(&FRRTrainingJob::execute, this);
+}
+
+void FRRTrainingJob::wait()
+{
+	if (_worker.joinable()) _worker.join();
+}
+
+FRRTrainingJob::State FRRTrainingJob::finish(State state)
+{
+	if (state == kDone) _progress = 100;
+	_state = state;
+	return state;
+}
+
+void FRRTrainingJob::report(const MString& message, bool error)
+{
+	std::lock_guard<std::mutex> lock(_messageLock);
+	_messages.append(message);
+	_messageIsError.push_back(error);
+}
+
+// Show the collected messages (main thread only)
+void FRRTrainingJob::showMessages()
+{
+	std::lock_guard<std::mutex> lock(_messageLock);
+	for (unsigned int i = 0; i < _messages.length(); i++)
+	{
+		if (_messageIsError[i]) MGlobal::displayError(_messages[i]);
+		else MGlobal::displayInfo(_messages[i]);
+	}
+	_messages.clear();
+	_messageIsError.clear();
+}
+
+
+FRRTrainingJob::State FRRTrainingJob::run()
+{
+	_state = kRunning;
+	_cancel = false;
+	return execute();
+}
+
+// The job itself, _cancel is reset by run() or start() before it begins
+FRRTrainingJob::State FRRTrainingJob::execute()
+{
+	_progress = 0;
+
+	unsigned int humanFaceDim;
+	unsigned int cartoonFaceDim;
+	unsigned int numDataPair;
+	unsigned int numSamplePair;	//numSamplePair -> the frame number of a new input animation
+
+
+	//Initialize the object of RBF class
+	//Set basis function as hardy multiquadric function
+	rbf rbfn;
+	rbfn.setBasisFunc( rbf::BF_HARDY );
+	rbfn.setLamda(0.1);
+	rbfn.setLowMemory(lowMemory);
+
+
+	//Import training sample data matrix from input files.
+	//The rows are used in place in the parsed files (input : humanFace, output : cartoonFace)
+	rbfMatrixView input, output;
+	FRRDataCache::Matrix humanFace, cartoonFace;
+	std::vector<char> modelBytes;
+	if (useModel.length() > 0)
+	{
+		//Use the network saved in a bundle by an earlier run (-saveModel) instead of the ROE data
+		FRRMappedFile bundle;
+		const char* data;
+		size_t size;
+		if (!FRRBundle::mapSection(useModel.asChar(), FRRBundle::kModel, bundle, data, size) || rbfn.Load(data, size) != 0) {
+			report("Cannot read the model " + useModel, true);
+			return finish(kFailed);
+		}
+		modelBytes.assign(data, data + size);
+		humanFaceDim = rbfn.getDimInput();
+		cartoonFaceDim = rbfn.getDimOutput();
+		numDataPair = rbfn.getNumCenters();
+	}
+	else
+	{
+		humanFace = FRRTRAININGCmd::importMatrix(blendFile, input);
+		cartoonFace = FRRTRAININGCmd::importMatrix(cvFile, output);
+		if (!humanFace || !cartoonFace || input.rows == 0 || output.rows == 0) {
+			report("Cannot read the ROE data!", true);
+			return finish(kFailed);
+		}
+
+
+		//Initialize the dimension of the source&target data and the number of data pair
+		humanFaceDim = input.cols;
+		cartoonFaceDim = output.cols;
+		if (input.rows != output.rows) {
+			report("Data Pair Size is different!", true);
+			return finish(kFailed);
+		}
+		numDataPair = input.rows;
+	}
+
+	_progress = 10;
+	if (_cancel) return finish(kCancelled);
+
+
+	//Import source animation data matrix from file.
+	//With -pipeline, it is read and parsed on another thread while the network is trained
+	Clock::time_point pipelineStart = Clock::now();
+	FRRDataCache::Matrix source;
+	rbfMatrixView srcInput;
+	double readTime = 0.0, trainTime = 0.0, interpolateTime = 0.0, sourceWait = 0.0, writerWait = 0.0;
+	std::future<void> sourceReady = std::async(pipeline ? std::launch::async : std::launch::deferred,
+		&FRRTrainingJob::importSource, this, std::ref(source), std::ref(srcInput), std::ref(readTime));
+	std::vector<double> result;		// numSamplePair x cartoonFaceDim, row major
+
+	// With -pipeline, the result chunks of a .dat file are written while the next ones are interpolated
+	const bool streamResult = pipeline && adaptiveTolerance < 0.0
+		&& !FRRMatrixFile::isMatrixFileName(finalFile.asChar()) && !FRRAnimFile::isAnimFileName(finalFile.asChar());
+	FRRResultWriter writer(result, cartoonFaceDim);
+
+	int numEvaluated = 0;
+	bool trained = false;
+	if (cacheDir.length() > 0)
+	{
+		// The source frames address the cached chunks, so they are needed first
+		Clock::time_point waitStart = Clock::now();
+		sourceReady.get();
+		sourceWait = secondsSince(waitStart);
+		if (!checkSource(source, srcInput, humanFaceDim)) return finish(kFailed);
+		numSamplePair = srcInput.rows;
+		result.resize(numSamplePair * cartoonFaceDim);
+		_progress = 20;
+		if (_cancel) return finish(kCancelled);
+		if (streamResult && !writer.open(finalFile.asChar())) {
+			report("Cannot write " + finalFile, true);
+			return finish(kFailed);
+		}
+
+		// Reuse the result chunks of earlier runs, train and evaluate only the missing ones
+		FRRResultCache cache(cacheDir.asChar());
+		if (!cache.create()) {
+			report("Cannot create the cache directory " + cacheDir, true);
+			return finish(kFailed);
+		}
+		unsigned long long modelKey;
+		if (modelBytes.empty())
+		{
+			modelKey = FRRResultCache::hashRows(input, 0, numDataPair, FRR_CACHE_VERSION);
+			modelKey = FRRResultCache::hashRows(output, 0, numDataPair, modelKey);
+		}
+		else
+		{
+			modelKey = FRRResultCache::hashBytes(&modelBytes[0], modelBytes.size(), FRR_CACHE_VERSION);
+		}
+		double options[7] = { rbfn.getLamda(), (double)rbfn.getBasisFunc(), greedy ? (double)maxCenters : -1.0, greedy ? tolerance : -1.0, adaptiveTolerance, pruneThreshold, lowMemory ? 1.0 : 0.0 };
+		modelKey = FRRResultCache::hashBytes(options, sizeof(options), modelKey);
+
+		// Adaptive interpolation depends on the chunk boundaries : one chunk for the whole sequence
+		unsigned int chunkSize = (adaptiveTolerance >= 0.0) ? numSamplePair : FRR_CACHE_CHUNK;
+		for (unsigned int begin = 0; begin < numSamplePair; begin += chunkSize)
+		{
+			if (_cancel) return finish(kCancelled);
+			_progress = 20 + 75 * begin / numSamplePair;
+
+			int numRows = (begin + chunkSize < numSamplePair) ? chunkSize : numSamplePair - begin;
+			unsigned long long key = FRRResultCache::hashRows(srcInput, begin, begin + numRows, modelKey);
+			double* chunkResult = &result[begin * cartoonFaceDim];
+			if (!cache.load(key, chunkResult, numRows, cartoonFaceDim))
+			{
+				if (!trained) {
+					Clock::time_point trainStart = Clock::now();
+					if (!trainNetwork(rbfn, input, output)) return finish(kFailed);
+					trainTime = secondsSince(trainStart);
+					trained = true;
+				}
+				Clock::time_point chunkStart = Clock::now();
+				numEvaluated += interpolateFrames(rbfn, srcInput.row(begin), numRows, chunkResult);
+				interpolateTime += secondsSince(chunkStart);
+				cache.store(key, chunkResult, numRows, cartoonFaceDim);
+			}
+			if (streamResult) writer.push(begin + numRows);
+		}
+
+		MString info("FRRTraining: cache hits ");
+		info += cache.hits();
+		info += ", misses ";
+		info += cache.misses();
+		report(info);
+		if (cache.failures() > 0) {
+			MString warning("FRRTraining: ");
+			warning += cache.failures();
+			warning += " result chunks could not be written to " + cacheDir;
+			report(warning);
+		}
+	}
+	else
+	{
+		//Train RBF network from the source and target ROE data
+		Clock::time_point trainStart = Clock::now();
+		if (!trainNetwork(rbfn, input, output)) return finish(kFailed);
+		trainTime = secondsSince(trainStart);
+		trained = true;
+
+		Clock::time_point waitStart = Clock::now();
+		sourceReady.get();
+		sourceWait = secondsSince(waitStart);
+		if (!checkSource(source, srcInput, humanFaceDim)) return finish(kFailed);
+		numSamplePair = srcInput.rows;
+		result.resize(numSamplePair * cartoonFaceDim);
+
+		_progress = 40;
+		if (_cancel) return finish(kCancelled);
+		if (streamResult && !writer.open(finalFile.asChar())) {
+			report("Cannot write " + finalFile, true);
+			return finish(kFailed);
+		}
+
+		// Run RBF interpolation
+		Clock::time_point interpolateStart = Clock::now();
+		if (adaptiveTolerance >= 0.0)
+		{
+			numEvaluated = interpolateFrames(rbfn, srcInput.data, numSamplePair, result.empty() ? NULL : &result[0]);
+		}
+		else
+		{
+			// Frame by frame results do not depend on each other, so run it in chunks
+			// to report the progress and to stay cancellable
+			for (unsigned int begin = 0; begin < numSamplePair; begin += FRR_CACHE_CHUNK)
+			{
+				if (_cancel) return finish(kCancelled);
+				_progress = 40 + 55 * begin / numSamplePair;
+
+				int numRows = (begin + FRR_CACHE_CHUNK < numSamplePair) ? FRR_CACHE_CHUNK : numSamplePair - begin;
+				numEvaluated += interpolateFrames(rbfn, srcInput.row(begin), numRows, &result[begin * cartoonFaceDim]);
+				if (streamResult) writer.push(begin + numRows);
+			}
+		}
+		interpolateTime = secondsSince(interpolateStart);
+	}
+
+	if (adaptiveTolerance >= 0.0)
+	{
+		MString info("FRRTraining: evaluated ");
+		info += numEvaluated;
+		info += " of ";
+		info += (int)numSamplePair;
+		info += " frames";
+		report(info);
+	}
+
+	_progress = 95;
+	if (_cancel) return finish(kCancelled);
+
+	//Store the trained network in a bundle (-useModel reads it back)
+	if (saveModel.length() > 0)
+	{
+		if (!trained && !trainNetwork(rbfn, input, output)) return finish(kFailed);
+		std::string bundleName, modelName;
+		std::vector<FRRBundle::Section> sections(1);
+		if (!FRRBundle::splitPath(saveModel.asChar(), bundleName, modelName)
+			|| !FRRBundle::modelSection(sections[0], modelName, rbfn) || !FRRBundle::append(bundleName.c_str(), sections)) {
+			report("Cannot save the model to " + saveModel, true);
+			return finish(kFailed);
+		}
+	}
+
+	//export the final result matrix to file (with the controller names of a binary cv file)
+	Clock::time_point writeStart = Clock::now();
+	if (streamResult)
+	{
+		if (!writer.finish()) {
+			report("Cannot write " + finalFile, true);
+			return finish(kFailed);
+		}
+		writerWait = secondsSince(writeStart);
+	}
+	else
+	{
+		std::vector<std::string> names;
+		FRRMatrixFile cvMatrix;
+		if (cvMatrix.open(cvFile.asChar()))
+		{
+			for (int j = 0; j < cvMatrix.cols(); j++) names.push_back(cvMatrix.colName(j));
+		}
+		FRRTRAININGCmd::exportData(result.empty() ? NULL : &result[0], numSamplePair, cartoonFaceDim, finalFile, names);
+		writer.busyTime = secondsSince(writeStart);
+	}
+
+	if (pipeline)
+	{
+		// The stages overlap by the time they took over the wall time, the main thread was
+		// idle while it waited for the source and for the last chunks to be written
+		double wallTime = secondsSince(pipelineStart);
+		double stageTime = readTime + trainTime + interpolateTime + writer.busyTime;
+		MString info("FRRTraining: read ");
+		info += readTime;
+		info += "s, train ";
+		info += trainTime;
+		info += "s, interpolate ";
+		info += interpolateTime;
+		info += "s, write ";
+		info += writer.busyTime;
+		info += "s, wall ";
+		info += wallTime;
+		info += "s, overlap ";
+		info += (stageTime > wallTime) ? stageTime - wallTime : 0.0;
+		info += "s, idle ";
+		info += sourceWait;
+		info += "s (source) ";
+		info += writerWait;
+		info += "s (writer)";
+		report(info);
+	}
+
+	return finish(kDone);
+}
+
+// This function imports the source animation (srcInput is a view of the parsed rows of source)
+void FRRTrainingJob::importSource(FRRDataCache::Matrix& source, rbfMatrixView& srcInput, double& seconds)
+{
+	Clock::time_point start = Clock::now();
+	source = FRRTRAININGCmd::importMatrix(sourceFile, srcInput);
+	seconds = secondsSince(start);
+}
+
+// This function checks that the source animation was read and has a weight per source blendshape
+bool FRRTrainingJob::checkSource(const FRRDataCache::Matrix& source, const rbfMatrixView& srcInput, unsigned int humanFaceDim)
+{
+	if (!source) {
+		report("Cannot read the source animation!", true);
+		return false;
+	}
+	if (srcInput.rows > 0 && srcInput.cols != (int)humanFaceDim) {
+		report("Source animation size is different!", true);
+		return false;
+	}
+	return true;
+}
+
+// This function trains the RBF network from the source and target ROE data
+// (with -useModel the network is already loaded, it is only pruned)
+bool FRRTrainingJob::trainNetwork(rbf& rbfn, const rbfMatrixView& input, const rbfMatrixView& output)
+{
+	if (useModel.length() > 0)
+	{
+		// Loaded from the bundle by execute()
+	}
+	else if (greedy)
+	{
+		// Keep only the centers needed to reach the tolerance (or the budget)
+		if (rbfn.TrainGreedy(input, output, maxCenters, tolerance) != 0) {
+			report("Greedy training failed!", true);
+			return false;
+		}
+		MString info("FRRTraining: kept ");
+		info += rbfn.getNumCenters();
+		info += " of ";
+		info += input.rows;
+		info += " centers, fit error ";
+		info += rbfn.getFitError();
+		report(info);
+	}
+	else
+	{
+		if (rbfn.Train(input, output) != 0) {
+			report("Training failed (singular basis matrix)!", true);
+			return false;
+		}
+	}
+
+	if (pruneThreshold > 0.0)
+	{
+		// Drop the small weights, Interpolate() uses the sparse weights then
+		if (rbfn.Prune(pruneThreshold) != 0) {
+			report("Weight pruning failed!", true);
+			return false;
+		}
+		MString info("FRRTraining: kept ");
+		info += 100.0 * rbfn.getWeightDensity();
+		info += "% of the weights, max error ";
+		info += rbfn.getPruneError();
+		report(info);
+	}
+	return true;
+}
+
+// This function runs RBF interpolation on numSample frames of sample into result (row major),
+// and returns the number of frames the RBF was evaluated on
+int FRRTrainingJob::interpolateFrames(rbf& rbfn, const double* sample, int numSample, double* result)
+{
+	if (adaptiveTolerance >= 0.0)
+	{
+		// Evaluate only the frames needed to reconstruct the rest within the tolerance
+		int numEvaluated = 0;
+		rbfn.InterpolateAdaptive(sample, numSample, result, adaptiveTolerance, numEvaluated);
+		return numEvaluated;
+	}
+	rbfn.InterpolateBatch(sample, numSample, result);
+	return numSample;
+}
+
+
+
+const char *jobStatusFlag = "-st", *jobStatusLongFlag = "-status";
+const char *jobProgressFlag = "-p", *jobProgressLongFlag = "-progress";
+const char *jobCancelFlag = "-c", *jobCancelLongFlag = "-cancel";
+const char *jobWaitFlag = "-w", *jobWaitLongFlag = "-wait";
+
+MSyntax FRRTRAININGJOBCmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(jobStatusFlag, jobStatusLongFlag);
+	syntax.addFlag(jobProgressFlag, jobProgressLongFlag);
+	syntax.addFlag(jobCancelFlag, jobCancelLongFlag);
+	syntax.addFlag(jobWaitFlag, jobWaitLongFlag);
+	return syntax;
+}
+
+MStatus FRRTRAININGJOBCmd::doIt(const MArgList &args)
+{
+	static const char* stateNames[] = { "idle", "running", "done", "failed", "cancelled" };
+
+	MArgDatabase argData(syntax(), args);
+	FRRTrainingJob* job = FRRTrainingJob::background;
+	if (job == NULL)
+	{
+		if (argData.isFlagSet(jobProgressFlag)) setResult(0);
+		else setResult(MString(stateNames[FRRTrainingJob::kIdle]));
+		return MS::kSuccess;
+	}
+
+	if (argData.isFlagSet(jobCancelFlag))
+		job->cancel();
+
+	if (argData.isFlagSet(jobWaitFlag))
+	{
+		// Block with Maya's progress bar, Esc cancels the job
+		MComputation computation;
+		computation.beginComputation(true);
+		computation.setProgressRange(0, 100);
+		while (job->state() == FRRTrainingJob::kRunning)
+		{
+			if (computation.isInterruptRequested()) job->cancel();
+			computation.setProgress(job->progress());
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		computation.endComputation();
+	}
+
+	// Messages of the worker are shown here, on the main thread
+	if (job->state() != FRRTrainingJob::kRunning)
+		job->showMessages();
+
+	if (argData.isFlagSet(jobProgressFlag)) setResult(job->progress());
+	else setResult(MString(stateNames[job->state()]));
+
+	return MS::kSuccess;
+}
@@ -0,0 +1,82 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRTRAININGJOBCmd
+#define _FRRTRAININGJOBCmd
+
+#include "global.h"
+#include "rbfKernel.h"
+#include "FRR_dataCache.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+// One retargeting run of FRRTraining : import the ROE data, train, interpolate the source
+// animation and export the result. The parsed data is used in place (views of the data cache
+// entries) and the result is computed into one buffer, which is written out as is.
+// It runs on the calling thread, or on a worker thread for
+// FRRTraining -async. While running it does not touch the scene or call MGlobal (only the
+// MString/MStringArray value types are used), messages are collected and shown later by the
+// main thread (showMessages()).
+class FRRTrainingJob
+{
+public:
+	enum State { kIdle, kRunning, kDone, kFailed, kCancelled };
+
+	FRRTrainingJob();
+	~FRRTrainingJob();
+
+	State	run();					// run on the calling thread
+	void	start();				// run on a worker thread (a cancel() after start() is never lost)
+	void	cancel()				{ _cancel = true; }
+	void	wait();
+	State	state() const			{ return (State)_state.load(); }
+	int		progress() const		{ return _progress; }
+	void	showMessages();
+
+	static FRRTrainingJob* background;		// job started by FRRTraining -async
+
+	// Options
+	MString	blendFile;
+	MString	cvFile;
+	MString	sourceFile;
+	MString	finalFile;
+	MString	cacheDir;
+	int		maxCenters;				// 0 : no center budget
+	double	tolerance;
+	bool	greedy;					// select centers greedily when a budget or tolerance is given
+	double	adaptiveTolerance;		// < 0 : evaluate the RBF on every frame
+	bool	lowMemory;
+	double	pruneThreshold;			// > 0 : prune the weights smaller than this ratio of the column max
+	bool	pipeline;				// read the source while training, write the result while interpolating
+	MString	saveModel;				// "koko.frb:name" : store the trained network in a bundle
+	MString	useModel;				// "koko.frb:name" : use a stored network instead of training
+
+private:
+	State	execute();
+	void	importSource(FRRDataCache::Matrix& source, rbfMatrixView& srcInput, double& seconds);
+	bool	checkSource(const FRRDataCache::Matrix& source, const rbfMatrixView& srcInput, unsigned int humanFaceDim);
+	bool	trainNetwork(rbf& rbfn, const rbfMatrixView& input, const rbfMatrixView& output);
+	int		interpolateFrames(rbf& rbfn, const double* sample, int numSample, double* result);
+	State	finish(State state);
+	void	report(const MString& message, bool error = false);
+
+	std::thread			_worker;
+	std::atomic<int>	_state;
+	std::atomic<int>	_progress;		// 0 ~ 100
+	std::atomic<bool>	_cancel;
+	std::mutex			_messageLock;
+	MStringArray		_messages;
+	std::vector<bool>	_messageIsError;
+};
+
+// FRRTrainingJob -status / -progress / -cancel / -wait : query or control the background job
+class FRRTRAININGJOBCmd : public MPxCommand
+{
+public:
+	virtual MStatus	doIt(const MArgList&);
+	virtual bool isUndoable() const { return false; }
+
+	static void *creator() { return new FRRTRAININGJOBCmd; }
+	static MSyntax newSyntax();
+};
+
+#endif
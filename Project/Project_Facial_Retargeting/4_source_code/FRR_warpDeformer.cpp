@@ -0,0 +1,167 @@
+//deformer -type frrWarpDeformer headMesh;
+//connectAttr locator1.worldPosition[0] frrWarpDeformer1.targetMarker[0];
+
+#include "FRR_warpDeformer.h"
+
+// For local testing of nodes you can use any identifier between
+// 0x00000000 and 0x0007ffff
+MTypeId     FRRWARPDEFORMERNode::id(0x00000240);
+
+// Attributes
+MObject     FRRWARPDEFORMERNode::aRestMarker;
+MObject     FRRWARPDEFORMERNode::aTargetMarker;
+
+
+FRRWARPDEFORMERNode::FRRWARPDEFORMERNode()
+{
+	_rbf.setBasisFunc(rbf::BF_HARDY);
+	_rbf.setLamda(0.0);		// markers are matched exactly
+}
+
+
+FRRWARPDEFORMERNode::~FRRWARPDEFORMERNode()
+{
+}
+
+
+void* FRRWARPDEFORMERNode::creator()
+{
+	return new FRRWARPDEFORMERNode();
+}
+
+
+// Reshape flat xyz positions to the rows of the rbf input
+static void toRows(const std::vector<double>& flat, vector<vector<double>>& rows)
+{
+	unsigned int num = flat.size() / 3;
+	rows.resize(num);
+	for (unsigned int i = 0; i < num; i++)
+	{
+		vector<double> temp(3);
+		for (unsigned int k = 0; k < 3; k++) temp(k) = flat[i * 3 + k];
+		rows(i) = temp;
+	}
+}
+
+
+MStatus FRRWARPDEFORMERNode::deform(MDataBlock& data, MItGeometry& itGeo,
+	const MMatrix& localToWorldMatrix, unsigned int geomIndex)
+{
+	MStatus status;
+
+	float env = data.inputValue(envelope).asFloat();
+	if (env == 0.0) return MS::kSuccess;
+
+	MArrayDataHandle restArray = data.inputArrayValue(aRestMarker, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	MArrayDataHandle targetArray = data.inputArrayValue(aTargetMarker, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	// Read the marker positions, paired by logical index (the arrays can be sparse,
+	// e.g. after a marker was deleted). A rest marker without a target is skipped.
+	unsigned int numRest = restArray.elementCount();
+	std::vector<double> rest, target;
+	rest.reserve(numRest * 3);
+	target.reserve(numRest * 3);
+	for (unsigned int i = 0; i < numRest; i++)
+	{
+		restArray.jumpToArrayElement(i);
+		unsigned int idx = restArray.elementIndex();
+		if (!targetArray.jumpToElement(idx)) continue;
+		double3 &restPos = restArray.inputValue().asDouble3();
+		double3 &targetPos = targetArray.inputValue().asDouble3();
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			rest.push_back(restPos[k]);
+			target.push_back(targetPos[k]);
+		}
+	}
+	unsigned int numMarker = rest.size() / 3;
+	if (numMarker == 0) return MS::kSuccess;
+
+	// Train again only when the rest pose changed.
+	// When only the targets moved, the weights are solved with the cached inverse basis matrix.
+	if (rest != _cachedRest || target != _cachedTarget)
+	{
+		std::vector<double> displacement(numMarker * 3);
+		for (unsigned int i = 0; i < numMarker * 3; i++) displacement[i] = target[i] - rest[i];
+
+		vector<vector<double>> output;
+		toRows(displacement, output);
+
+		int res;
+		if (rest != _cachedRest)
+		{
+			vector<vector<double>> input;
+			toRows(rest, input);
+			res = _rbf.Train(input, output);
+		}
+		else
+		{
+			res = _rbf.SolveWeights(output);
+		}
+
+		if (res != 0)
+		{
+			// e.g. two markers at the same rest position
+			_cachedRest.clear();
+			_cachedTarget.clear();
+			return MS::kSuccess;
+		}
+		_cachedRest = rest;
+		_cachedTarget = target;
+	}
+
+	// Evaluate the displacements of all vertices at once (in world space)
+	MPointArray points;
+	itGeo.allPositions(points);
+	unsigned int numPoint = points.length();
+	if (numPoint == 0) return MS::kSuccess;
+
+	std::vector<double> sample(numPoint * 3), displacement(numPoint * 3);
+	for (unsigned int i = 0; i < numPoint; i++)
+	{
+		MPoint worldPos = points[i] * localToWorldMatrix;
+		sample[i * 3 + 0] = worldPos.x;
+		sample[i * 3 + 1] = worldPos.y;
+		sample[i * 3 + 2] = worldPos.z;
+	}
+	_rbf.InterpolateBatch(&sample[0], numPoint, &displacement[0]);
+
+	MMatrix worldToLocalMatrix = localToWorldMatrix.inverse();
+	unsigned int i = 0;
+	for (itGeo.reset(); !itGeo.isDone(); itGeo.next(), i++)
+	{
+		float w = env * weightValue(data, geomIndex, itGeo.index());
+		MPoint worldPos(sample[i * 3 + 0] + w * displacement[i * 3 + 0],
+						sample[i * 3 + 1] + w * displacement[i * 3 + 1],
+						sample[i * 3 + 2] + w * displacement[i * 3 + 2]);
+		points[i] = worldPos * worldToLocalMatrix;
+	}
+	itGeo.setAllPositions(points);
+
+	return MS::kSuccess;
+}
+
+
+MStatus FRRWARPDEFORMERNode::initialize()
+{
+	MFnNumericAttribute nAttr;
+
+	// Create attribute for rest marker positions
+	aRestMarker = nAttr.create("restMarker", "rm", MFnNumericData::k3Double);
+	nAttr.setArray(true);
+	nAttr.setUsesArrayDataBuilder(true);
+	addAttribute(aRestMarker);
+	attributeAffects(aRestMarker, outputGeom);
+
+	// Create attribute for target marker positions
+	aTargetMarker = nAttr.create("targetMarker", "tm", MFnNumericData::k3Double);
+	nAttr.setArray(true);
+	nAttr.setUsesArrayDataBuilder(true);
+	addAttribute(aTargetMarker);
+	attributeAffects(aTargetMarker, outputGeom);
+
+	return MS::kSuccess;
+}
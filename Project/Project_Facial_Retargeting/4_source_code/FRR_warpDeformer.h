@@ -0,0 +1,41 @@
+#pragma warning(disable: 4996)
+#ifndef _FRRWARPDEFORMERNode
+#define _FRRWARPDEFORMERNode
+
+#include "global.h"
+#include "rbfKernel.h"
+#include <maya/MPxDeformerNode.h>
+#include <maya/MItGeometry.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MPointArray.h>
+#include <maya/MMatrix.h>
+
+// Scattered data mesh warp : marker displacements (target - rest) are interpolated
+// over the whole mesh with the rbf kernel.
+class FRRWARPDEFORMERNode : public MPxDeformerNode
+{
+public:
+						FRRWARPDEFORMERNode();
+	virtual				~FRRWARPDEFORMERNode();
+	static  void*		creator();
+
+	virtual MStatus     deform( MDataBlock& data,
+								MItGeometry& itGeo,
+								const MMatrix& localToWorldMatrix,
+								unsigned int geomIndex);
+
+	static  MStatus		initialize();
+
+	static  MTypeId		id;
+
+	// Attributes
+	static  MObject		aRestMarker;	// marker positions of the rest pose (world space)
+	static  MObject		aTargetMarker;	// current marker positions (world space)
+
+private:
+	rbf					_rbf;			// trained on the rest markers, outputs are the displacements
+	std::vector<double>	_cachedRest;	// rest markers the rbf was trained on
+	std::vector<double>	_cachedTarget;	// target markers the weights were solved for
+};
+
+#endif
@@ -84,7 +84,17 @@ def exportFinalResult(*args):
     mel.eval("FRRTraining -bfn " + srcROEFileName +
                         " -cfn " + trgROEFileName +
                         " -sfn " + srcAniFileName +
-                        " -ffn " + resultFileName)
+                        " -ffn " + resultFileName + " -async")
+    global trainingJob
+    trainingJob = cmds.scriptJob(idleEvent=pollTraining)
+# Poll the background training, Maya stays responsive meanwhile
+def pollTraining(*args):
+    status = mel.eval("FRRTrainingJob -status")
+    if status == "running":
+        cmds.headsUpMessage("Training " + str(mel.eval("FRRTrainingJob -progress")) + "%")
+        return
+    cmds.scriptJob(kill=trainingJob, force=True)
+    cmds.headsUpMessage("Training " + status)
 
 # For Importing Final Result FileName
 # Import Ctrl List File
@@ -6,19 +6,184 @@
 #include <boost/numeric/ublas/triangular.hpp>
 #include <boost/numeric/ublas/lu.hpp>
 #include <boost/numeric/ublas/io.hpp>
+#include <vector>
+#include <cmath>
 
 using namespace boost::numeric::ublas;
 
+#define LU_BLOCK_SIZE		64		// panel width and tile size of the blocked LU
+#define LU_PARALLEL_MIN		256		// below this size the LU runs on one thread
+
+
+// This function factorizes A in place into L (unit lower) and U with partial pivoting.
+// Right-looking blocked LU : each panel of LU_BLOCK_SIZE columns is factorized, then the
+// row block of U and the trailing matrix are updated tile by tile on all cores.
+// pivot(k) is the row swapped with row k at step k (same convention as ublas permutation_matrix).
+// Returns 0 on success, or (k + 1) when the pivot of column k is zero.
+template<class T>
+int BlockedLUFactorize(boost::numeric::ublas::matrix<T>& A, std::vector<std::size_t>& pivot)
+{
+	const int n = (int)A.size1();
+	pivot.resize(n);
+	if (n == 0) return 0;
+	T *a = &A.data()[0];		// row-major storage
+
+	for (int k0 = 0; k0 < n; k0 += LU_BLOCK_SIZE)
+	{
+		const int k1 = (k0 + LU_BLOCK_SIZE < n) ? k0 + LU_BLOCK_SIZE : n;
+
+		// 1. Factorize the panel (columns k0 ~ k1-1, rows k0 ~ n-1)
+		// One parallel region for the whole panel : the pivot search and the row swap of each
+		// column run on one thread, the elimination below it is shared by all threads.
+		int singular = 0;
+#pragma omp parallel if (n - k0 > LU_PARALLEL_MIN)
+		{
+			for (int j = k0; j < k1; j++)
+			{
+#pragma omp single
+				{
+					int p = j;
+					T pmax = std::fabs(a[j * n + j]);
+					for (int i = j + 1; i < n; i++)
+					{
+						if (std::fabs(a[i * n + j]) > pmax) { pmax = std::fabs(a[i * n + j]); p = i; }
+					}
+					pivot[j] = p;
+					if (pmax == T(0)) singular = j + 1;
+
+					// Swap whole rows, so the left part (L) and the right part are permuted too
+					else if (p != j)
+					{
+						T *rj = a + j * n, *rp = a + p * n;
+						for (int c = 0; c < n; c++) { T t = rj[c]; rj[c] = rp[c]; rp[c] = t; }
+					}
+				}
+				if (singular) break;		// the same on every thread, after the barrier of single
+
+				const T *rj = a + j * n;
+				const T inv = T(1) / rj[j];
+#pragma omp for
+				for (int i = j + 1; i < n; i++)
+				{
+					T *ri = a + i * n;
+					const T l = (ri[j] *= inv);
+					for (int c = j + 1; c < k1; c++) ri[c] -= l * rj[c];
+				}
+			}
+		}
+		if (singular) return singular;
+		if (k1 == n) break;
+
+		// 2. Row block of U : U12 = L11^-1 * A12, independent per column tile
+		const int numColTile = (n - k1 + LU_BLOCK_SIZE - 1) / LU_BLOCK_SIZE;
+#pragma omp parallel for schedule(dynamic) if (n > LU_PARALLEL_MIN)
+		for (int t = 0; t < numColTile; t++)
+		{
+			const int c0 = k1 + t * LU_BLOCK_SIZE;
+			const int c1 = (c0 + LU_BLOCK_SIZE < n) ? c0 + LU_BLOCK_SIZE : n;
+			for (int i = k0 + 1; i < k1; i++)
+			{
+				T *ri = a + i * n;
+				for (int m = k0; m < i; m++)
+				{
+					const T l = ri[m];
+					const T *rm = a + m * n;
+					for (int c = c0; c < c1; c++) ri[c] -= l * rm[c];
+				}
+			}
+		}
+
+		// 3. Trailing update : A22 -= L21 * U12, one task per (row tile, column tile)
+		const int numRowTile = (n - k1 + LU_BLOCK_SIZE - 1) / LU_BLOCK_SIZE;
+		const int numTile = numRowTile * numColTile;
+#pragma omp parallel for schedule(dynamic) if (n > LU_PARALLEL_MIN)
+		for (int t = 0; t < numTile; t++)
+		{
+			const int r0 = k1 + (t / numColTile) * LU_BLOCK_SIZE;
+			const int r1 = (r0 + LU_BLOCK_SIZE < n) ? r0 + LU_BLOCK_SIZE : n;
+			const int c0 = k1 + (t % numColTile) * LU_BLOCK_SIZE;
+			const int c1 = (c0 + LU_BLOCK_SIZE < n) ? c0 + LU_BLOCK_SIZE : n;
+			for (int i = r0; i < r1; i++)
+			{
+				T *ri = a + i * n;
+				for (int m = k0; m < k1; m++)
+				{
+					const T l = ri[m];
+					const T *rm = a + m * n;
+					for (int c = c0; c < c1; c++) ri[c] -= l * rm[c];
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+// This function solves A * X = B for all columns of B at once, given the factorization of A
+// from BlockedLUFactorize(). B is overwritten by X. Right hand sides are split into column
+// tiles, which are substituted independently on all cores.
+template<class T>
+void BlockedLUSubstitute(const boost::numeric::ublas::matrix<T>& LU, const std::vector<std::size_t>& pivot, boost::numeric::ublas::matrix<T>& B)
+{
+	const int n = (int)LU.size1();
+	const int r = (int)B.size2();
+	if (n == 0 || r == 0) return;
+	const T *a = &LU.data()[0];
+	T *b = &B.data()[0];
+
+	const int numColTile = (r + LU_BLOCK_SIZE - 1) / LU_BLOCK_SIZE;
+#pragma omp parallel for schedule(dynamic) if (n > LU_PARALLEL_MIN)
+	for (int t = 0; t < numColTile; t++)
+	{
+		const int c0 = t * LU_BLOCK_SIZE;
+		const int c1 = (c0 + LU_BLOCK_SIZE < r) ? c0 + LU_BLOCK_SIZE : r;
+
+		// Row interchanges
+		for (int i = 0; i < n; i++)
+		{
+			const int p = (int)pivot[i];
+			if (p == i) continue;
+			T *bi = b + i * r, *bp = b + p * r;
+			for (int c = c0; c < c1; c++) { T tmp = bi[c]; bi[c] = bp[c]; bp[c] = tmp; }
+		}
+		// Forward substitution with unit L
+		for (int i = 1; i < n; i++)
+		{
+			T *bi = b + i * r;
+			const T *ai = a + i * n;
+			for (int m = 0; m < i; m++)
+			{
+				const T l = ai[m];
+				if (l == T(0)) continue;
+				const T *bm = b + m * r;
+				for (int c = c0; c < c1; c++) bi[c] -= l * bm[c];
+			}
+		}
+		// Back substitution with U
+		for (int i = n - 1; i >= 0; i--)
+		{
+			T *bi = b + i * r;
+			const T *ai = a + i * n;
+			for (int m = i + 1; m < n; m++)
+			{
+				const T u = ai[m];
+				const T *bm = b + m * r;
+				for (int c = c0; c < c1; c++) bi[c] -= u * bm[c];
+			}
+			const T inv = T(1) / ai[i];
+			for (int c = c0; c < c1; c++) bi[c] *= inv;
+		}
+	}
+}
+
 template<class T>
 
 bool InvertMatrix(const boost::numeric::ublas::matrix<T>& input, boost::numeric::ublas::matrix<T>& inverse)
 {
-	typedef permutation_matrix<std::size_t> pmatrix;
 	matrix<T> A(input);
-	pmatrix pm(A.size1());
-	int res = lu_factorize(A, pm);
+	std::vector<std::size_t> pivot;
+	int res = BlockedLUFactorize(A, pivot);
 	if (res != 0) return false;
 	inverse.assign(boost::numeric::ublas::identity_matrix<T>(A.size1()));
-	lu_substitute(A, pm, inverse);
+	BlockedLUSubstitute(A, pivot, inverse);
 	return true;
-}
\ No newline at end of file
+}
@@ -2,7 +2,16 @@
 #include "FRR_CVExport.h"
 #include "FRR_ctrlListExport.h"
 #include "FRR_Training.h"
+#include "FRR_trainingJob.h"
 #include "FRR_CVImport.h"
+#include "FRR_retarget.h"
+#include "FRR_capture.h"
+#include "FRR_warpDeformer.h"
+#include "FRR_retargetNode.h"
+#include "FRR_poseDeformer.h"
+#include "FRR_convert.h"
+#include "FRR_dataCache.h"
+#include "FRR_bundleCmd.h"
 #include <maya/MFnPlugin.h>
 
 MStatus initializePlugin(MObject obj)
@@ -26,10 +35,46 @@ MStatus initializePlugin(MObject obj)
 	if (!stat)
 		stat.perror("registerCommand failed");
 
+	stat = plugin.registerCommand("FRRTrainingJob", FRRTRAININGJOBCmd::creator, FRRTRAININGJOBCmd::newSyntax);
+	if (!stat)
+		stat.perror("registerCommand failed");
+
 	stat = plugin.registerCommand("FRRCVImport", FRRCVIMPORTCmd::creator, FRRCVIMPORTCmd::newSyntax);
 	if (!stat)
 		stat.perror("registerCommand failed");
 
+	stat = plugin.registerCommand("FRRRetarget", FRRRETARGETCmd::creator, FRRRETARGETCmd::newSyntax);
+	if (!stat)
+		stat.perror("registerCommand failed");
+
+	stat = plugin.registerCommand("FRRCapture", FRRCAPTURECmd::creator, FRRCAPTURECmd::newSyntax);
+	if (!stat)
+		stat.perror("registerCommand failed");
+
+	stat = plugin.registerCommand("FRRConvert", FRRCONVERTCmd::creator, FRRCONVERTCmd::newSyntax);
+	if (!stat)
+		stat.perror("registerCommand failed");
+
+	stat = plugin.registerCommand("FRRCacheStats", FRRCACHESTATSCmd::creator, FRRCACHESTATSCmd::newSyntax);
+	if (!stat)
+		stat.perror("registerCommand failed");
+
+	stat = plugin.registerCommand("FRRBundle", FRRBUNDLECmd::creator, FRRBUNDLECmd::newSyntax);
+	if (!stat)
+		stat.perror("registerCommand failed");
+
+	stat = plugin.registerNode("frrWarpDeformer", FRRWARPDEFORMERNode::id, FRRWARPDEFORMERNode::creator, FRRWARPDEFORMERNode::initialize, MPxNode::kDeformerNode);
+	if (!stat)
+		stat.perror("registerNode failed");
+
+	stat = plugin.registerNode("frrRetargetNode", FRRRETARGETNode::id, FRRRETARGETNode::creator, FRRRETARGETNode::initialize);
+	if (!stat)
+		stat.perror("registerNode failed");
+
+	stat = plugin.registerNode("frrPoseDeformer", FRRPOSEDEFORMERNode::id, FRRPOSEDEFORMERNode::creator, FRRPOSEDEFORMERNode::initialize, MPxNode::kDeformerNode);
+	if (!stat)
+		stat.perror("registerNode failed");
+
 
 	return stat;
 }
@@ -54,9 +99,54 @@ MStatus uninitializePlugin(MObject obj)
 	if (!stat)
 		stat.perror("deregisterCommand failed");
 
+	stat = plugin.deregisterCommand("FRRTrainingJob");
+	if (!stat)
+		stat.perror("deregisterCommand failed");
+
+	// Stop the background training before the plugin code goes away
+	delete FRRTrainingJob::background;
+	FRRTrainingJob::background = NULL;
+
 	stat = plugin.deregisterCommand("FRRCVImport");
 	if (!stat)
 		stat.perror("deregisterCommand failed");
 
+	stat = plugin.deregisterCommand("FRRRetarget");
+	if (!stat)
+		stat.perror("deregisterCommand failed");
+
+	stat = plugin.deregisterCommand("FRRCapture");
+	if (!stat)
+		stat.perror("deregisterCommand failed");
+
+	stat = plugin.deregisterCommand("FRRConvert");
+	if (!stat)
+		stat.perror("deregisterCommand failed");
+
+	stat = plugin.deregisterCommand("FRRCacheStats");
+	if (!stat)
+		stat.perror("deregisterCommand failed");
+
+	stat = plugin.deregisterCommand("FRRBundle");
+	if (!stat)
+		stat.perror("deregisterCommand failed");
+	FRRDataCache::clear();
+
+	// Stop the capture threads before the plugin code goes away
+	delete FRRCapture::active;
+	FRRCapture::active = NULL;
+
+	stat = plugin.deregisterNode(FRRWARPDEFORMERNode::id);
+	if (!stat)
+		stat.perror("deregisterNode failed");
+
+	stat = plugin.deregisterNode(FRRRETARGETNode::id);
+	if (!stat)
+		stat.perror("deregisterNode failed");
+
+	stat = plugin.deregisterNode(FRRPOSEDEFORMERNode::id);
+	if (!stat)
+		stat.perror("deregisterNode failed");
+
 	return stat;
 }
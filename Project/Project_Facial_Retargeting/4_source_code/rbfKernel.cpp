@@ -1,9 +1,24 @@
 #include "rbfKernel.h"
+#include <cstring>
 
 
+// This function packs the rows into one row-major buffer and returns its view
+// (for the vector of vector overloads, which are kept for the callers building rows)
+static rbfMatrixView packRows(const vector<vector<double>> &rows, std::vector<double> &buffer)
+{
+	int numRow = rows.size();
+	int dim = (numRow > 0) ? rows(0).size() : 0;
+	buffer.resize(numRow * dim);
+	for (int i = 0; i < numRow; i++)
+	{
+		std::copy(rows(i).begin(), rows(i).end(), buffer.begin() + i * dim);
+	}
+	return rbfMatrixView(buffer.empty() ? 0 : &buffer[0], numRow, dim);
+}
+
 // This function construct distance matrix (distMat) from sample data(input),
 // and find minimum distances of each samples and save it to minimum distance vector(_minDist)
-int	rbf::buildDistMatrix(matrix<double> &distMat, const vector<vector<double>> &input)
+int	rbf::buildDistMatrix(matrix<double> &distMat, const rbfMatrixView &input)
 {	
 
 	//---------------------------------------------------------------TODO---------------------------------------------------------------------------//
@@ -11,12 +26,13 @@ int	rbf::buildDistMatrix(matrix<double> &distMat, const vector<vector<double>> &
 	//	Compute distance from one point(source expression vector) to other points of sample data by using dist() funciton, and save it to distMat
 	//----------------------------------------------------------------------------------------------------------------------------------------------//
 
-	_numInput = input.size();
+	_numInput = input.rows;
+	buildSparseCenters(input);
 	for (int i = 0; i < _numInput; i++) {
-		vector<double> srcPoint = input[i];
+		const double *srcPoint = input.row(i);
+		double srcNorm = sampleNorm(srcPoint);
 		for (int j = 0; j < _numInput; j++) {
-			vector<double> trgPoint = input[j];
-			distMat(i, j) = dist(srcPoint, trgPoint);
+			distMat(i, j) = centerDist(srcPoint, srcNorm, j);
 		}
 	}
 
@@ -36,7 +52,7 @@ int	rbf::buildDistMatrix(matrix<double> &distMat, const vector<vector<double>> &
 }
 
 // basis function
-double rbf::basisFunc(int i, double x2)
+double rbf::basisFunc(int i, double x2) const
 {
 	if (_basisFunc == BF_HARDY) // Hardy 
 	{
@@ -46,28 +62,116 @@ double rbf::basisFunc(int i, double x2)
 }
 
 // This function calculates distance from vector a to b
-inline double rbf::dist(const vector<double> &a, const vector<double> &b)
+inline double rbf::dist(const double *a, const double *b) const
 {
 	double d1, d2 = .0f;
-	size_t dim = a.size();
-	for (size_t i = 0; i < dim; i++)
+	for (int i = 0; i < _dimInput; i++)
 	{
-		d1 = a(i) - b(i);
+		d1 = a[i] - b[i];
 		d2 += d1 * d1;
 	}
 	return d2; // returns the square of distance
 }
 
+// This function stores the centers(input) in compressed sparse rows with their squared norms,
+// if at most RBF_SPARSE_DENSITY of the entries are nonzero (e.g. one-hot ROE data).
+// Otherwise the dense path of dist() is used.
+// The flat copy, which the dense path and the raw buffer interpolation use, is built as well.
+void rbf::buildSparseCenters(const rbfMatrixView &input)
+{
+	int numCenter = input.rows;
+	int dim = input.cols;
+
+	buildFlatCenters(input);
+
+	int nnz = 0;
+	for (int i = 0; i < numCenter; i++)
+	{
+		for (int k = 0; k < dim; k++)
+		{
+			if (input.row(i)[k] != 0.0) nnz++;
+		}
+	}
+
+	_centerPtr.clear();
+	_centerIdx.clear();
+	_centerVal.clear();
+	_centerNorm.resize(0);
+	_sparseInput = (numCenter > 0 && nnz <= RBF_SPARSE_DENSITY * numCenter * dim);
+	if (!_sparseInput) return;
+
+	_centerPtr.reserve(numCenter + 1);
+	_centerIdx.reserve(nnz);
+	_centerVal.reserve(nnz);
+	_centerNorm.resize(numCenter);
+
+	_centerPtr.push_back(0);
+	for (int i = 0; i < numCenter; i++)
+	{
+		double norm = .0f;
+		for (int k = 0; k < dim; k++)
+		{
+			double v = input.row(i)[k];
+			if (v == 0.0) continue;
+			_centerIdx.push_back(k);
+			_centerVal.push_back(v);
+			norm += v * v;
+		}
+		_centerPtr.push_back(_centerIdx.size());
+		_centerNorm(i) = norm;
+	}
+}
+
+// This function copies the centers(input) into one contiguous array with a fixed row stride
+// (padded with zeros to a multiple of RBF_CENTER_ALIGN). It is the only copy of the centers
+// the network keeps.
+void rbf::buildFlatCenters(const rbfMatrixView &input)
+{
+	int numCenter = input.rows;
+	int dim = input.cols;
+
+	_centerStride = (dim + RBF_CENTER_ALIGN - 1) / RBF_CENTER_ALIGN * RBF_CENTER_ALIGN;
+	_centerFlat.assign(numCenter * _centerStride, 0.0);
+	for (int i = 0; i < numCenter; i++)
+	{
+		std::copy(input.row(i), input.row(i) + dim, _centerFlat.begin() + i * _centerStride);
+	}
+}
+
+// This function returns the squared norm of a, which centerDist() needs for sparse centers
+inline double rbf::sampleNorm(const double *a) const
+{
+	if (!_sparseInput) return .0f;
+	double norm = .0f;
+	for (int k = 0; k < _dimInput; k++) norm += a[k] * a[k];
+	return norm;
+}
+
+// This function calculates the square of distance from vector a to the j-th center.
+// With sparse centers it is |a|^2 + |c|^2 - 2 a.c, which costs the nonzeros of the center only.
+inline double rbf::centerDist(const double *a, double normA, int j) const
+{
+	if (!_sparseInput) return dist(a, &_centerFlat[j * _centerStride]);
+
+	double dot = .0f;
+	for (int p = _centerPtr[j]; p < _centerPtr[j + 1]; p++)
+	{
+		dot += a[_centerIdx[p]] * _centerVal[p];
+	}
+	double d2 = normA + _centerNorm(j) - 2.0 * dot;
+	return (d2 > 0.0) ? d2 : 0.0;
+}
+
 
 // This function builds basis matrix and solve it.
 //   - calculate distance matrix
 //   - calculate basis matrix by using basis function
 //   - calculate inverse matrix by solving basis matrix
-int	rbf::buildBasisMat(const vector<vector<double>> &input)
+int	rbf::buildBasisMat(const rbfMatrixView &input)
 {
-	_numInput = input.size(); // numInput is the number of input data
+	_numInput = input.rows; // numInput is the number of input data
 	if (_numInput <= 0) return -1;
-	_dimInput = input(0).size(); // dimInput is the dimension of input data
+	_dimInput = input.cols; // dimInput is the dimension of input data
 
 	matrix<double> distMat(_numInput, _numInput);					
 	_minDist.resize(_numInput);										 
@@ -94,15 +198,79 @@ int	rbf::buildBasisMat(const vector<vector<double>> &input)
 	return 0;
 }
 
+// This function builds the basis matrix of the low memory mode, without distMat.
+// Squared distances are written straight into _basisMat together with the minimum distance
+// of each row (the distance matrix is symmetric, so it is also the one of each column),
+// then turned into basis values in place. _basisMat is the only N x N matrix allocated.
+int	rbf::buildBasisMatInPlace(const rbfMatrixView &input)
+{
+	_numInput = input.rows;
+	if (_numInput <= 0) return -1;
+	_dimInput = input.cols;
+
+	const int n = _numInput;
+	_minDist.resize(n);
+	_inverseBasisMat.resize(0, 0, false);
+	_basisMat.resize(n, n, false);
+	double *b = &_basisMat.data()[0];
+	buildSparseCenters(input);
+
+#pragma omp parallel for schedule(dynamic, 16) if (n > 256)
+	for (int i = 0; i < n; i++)
+	{
+		double dmin = FLT_MAX;
+		double norm = sampleNorm(input.row(i));
+		for (int j = 0; j < n; j++)
+		{
+			double d = centerDist(input.row(i), norm, j);
+			b[i * n + j] = d;
+			if (d < dmin && i != j) dmin = d;
+		}
+		_minDist(i) = dmin;
+	}
+
+#pragma omp parallel for if (n > 256)
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			b[i * n + j] = basisFunc(j, b[i * n + j]);
+		}
+		b[i * n + i] += _lamda;
+	}
+
+	return 0;
+}
+
+
 
 // This function trains the Radial Basis Function Network. (Get _weightMat (M_RBF in paper) from input and output)
-int rbf::Train(const vector<vector<double>> &input, const vector<vector<double>> &output)
+// The input is only read : it is copied once, into the flat centers (see buildFlatCenters).
+int rbf::Train(const rbfMatrixView &input, const rbfMatrixView &output)
 {
-	if (output.size() == 0) return -1;
+	if (output.rows == 0 || input.rows != output.rows) return -1;
 
 	//build basis matrix
-	_dimOutput = output(0).size();
-	_input = input;
+	_dimOutput = output.cols;
+	_prunedWeight = false;
+
+	// Low memory mode : factorize the basis matrix in place and solve the weights directly,
+	// then drop the factorization. The output is copied once, into _weightMat.
+	if (_lowMemory)
+	{
+		if (buildBasisMatInPlace(input) != 0) return -1;
+
+		_weightMat.resize(_numInput, _dimOutput, false);
+		for (int i = 0; i < _numInput; i++) {
+			std::copy(output.row(i), output.row(i) + _dimOutput, &_weightMat(i, 0));
+		}
+
+		std::vector<std::size_t> pivot;
+		if (BlockedLUFactorize(_basisMat, pivot) != 0) return -1;
+		BlockedLUSubstitute(_basisMat, pivot, _weightMat);
+		_basisMat.resize(0, 0, false);
+		return 0;
+	}
 
 
 	//---------------------------------------------------------------TODO---------------------------------------------------------------//
@@ -114,15 +282,13 @@ int rbf::Train(const vector<vector<double>> &input, const vector<vector<double>>
 	//----------------------------------------------------------------------------------------------------------------------------------//
 
 	// Build the basis matrix from input data
-	buildBasisMat(_input);
+	if (buildBasisMat(input) != 0) return -1;
 
-	// Change data type of output data from vector<vector<double>> to matrix<double> (for using prod() function of BOOST)
-	matrix<double> outMat(output.size(), _dimOutput);
+	// Change data type of output data to matrix<double> (for using prod() function of BOOST)
+	matrix<double> outMat(output.rows, _dimOutput);
 
-	for (int i = 0; i < output.size(); i++) {
-		for (int j = 0; j < _dimOutput; j++) {
-			outMat(i, j) = output[i][j];
-		}
+	for (int i = 0; i < output.rows; i++) {
+		std::copy(output.row(i), output.row(i) + _dimOutput, &outMat(i, 0));
 	}
 
 	// Calculate the matrix product of _inverseBasisMatrix and output data
@@ -132,6 +298,406 @@ int rbf::Train(const vector<vector<double>> &input, const vector<vector<double>>
 	return 0;
 }
 
+int rbf::Train(const vector<vector<double>> &input, const vector<vector<double>> &output)
+{
+	std::vector<double> inputBuffer, outputBuffer;
+	return Train(packRows(input, inputBuffer), packRows(output, outputBuffer));
+}
+
+
+
+// This function solves _weightMat again for new outputs at the same inputs.
+// The inverse basis matrix of the last Train() is reused, so only the product is computed
+// (not available after TrainGreedy() or in the low memory mode).
+int rbf::SolveWeights(const rbfMatrixView &output)
+{
+	if (output.rows != _numInput || _numInput <= 0) return -1;
+	if ((int)_inverseBasisMat.size1() != _numInput) return -1;
+
+	_dimOutput = output.cols;
+	_prunedWeight = false;
+	matrix<double> outMat(_numInput, _dimOutput);
+	for (int i = 0; i < _numInput; i++) {
+		std::copy(output.row(i), output.row(i) + _dimOutput, &outMat(i, 0));
+	}
+	_weightMat = prod(_inverseBasisMat, outMat);
+
+	return 0;
+}
+
+int rbf::SolveWeights(const vector<vector<double>> &output)
+{
+	std::vector<double> outputBuffer;
+	return SolveWeights(packRows(output, outputBuffer));
+}
+
+
+// This function trains the network on a subset of the input used as centers.
+// Centers are added greedily at the example with the largest residual until the maximum
+// absolute residual drops below tolerance or maxCenters is reached (maxCenters <= 0 means no budget).
+// Weights are the (lamda regularized) least squares fit over all examples, i.e. the least squares
+// solution of [A ; sqrt(lamda) I] W = [Y ; 0]. Its QR factorization is grown by one column per
+// center (Gram-Schmidt, orthogonalized twice), so each step costs O((N + k) k) instead of
+// inverting the k x k normal matrix, and the basis is never squared.
+int rbf::TrainGreedy(const rbfMatrixView &input, const rbfMatrixView &output, int maxCenters, double tolerance)
+{
+	if (output.rows == 0 || input.rows != output.rows) return -1;
+
+	int numExample = input.rows;
+	_dimInput = input.cols;
+	_dimOutput = output.cols;
+	_prunedWeight = false;
+	if (maxCenters <= 0 || maxCenters > numExample) maxCenters = numExample;
+
+	// Distances and basis values of every example against every candidate center
+	matrix<double> distMat(numExample, numExample);
+	_minDist.resize(numExample);
+	buildDistMatrix(distMat, input);
+
+	matrix<double> candMat(numExample, numExample);
+	for (int i = 0; i < numExample; i++)
+	{
+		for (int j = 0; j < numExample; j++)
+		{
+			candMat(i, j) = basisFunc(j, distMat(i, j));
+		}
+	}
+
+	// Rows of the regularized system : numExample examples, then one row per center
+	const int numRow = numExample + maxCenters;
+	const double sqrtLamda = sqrt(_lamda);
+
+	std::vector<int> centers;
+	std::vector<bool> used(numExample, false);
+	matrix<double> qMat(maxCenters, numRow, 0.0);			// orthonormal columns of Q, one per row
+	matrix<double> rMat(maxCenters, maxCenters, 0.0);		// upper triangular R
+	matrix<double> coefMat(maxCenters, _dimOutput);			// Q^T [Y ; 0]
+	matrix<double> residual(numRow, _dimOutput, 0.0);		// [Y ; 0] - [A ; sqrt(lamda) I] W
+	std::vector<double> newColumn(numRow);
+	for (int i = 0; i < numExample; i++) {
+		std::copy(output.row(i), output.row(i) + _dimOutput, &residual(i, 0));
+	}
+
+	while (true)
+	{
+		// Find the worst fitted example which is not a center yet
+		int best = -1;
+		double bestErr = -1.0;
+		_fitError = .0f;
+		for (int i = 0; i < numExample; i++)
+		{
+			double err = .0f;
+			for (int j = 0; j < _dimOutput; j++)
+			{
+				if (fabs(residual(i, j)) > err) err = fabs(residual(i, j));
+			}
+			if (err > _fitError) _fitError = err;
+			if (!used[i] && err > bestErr) { bestErr = err; best = i; }
+		}
+		if (centers.size() > 0 && _fitError <= tolerance) break;
+		if ((int)centers.size() >= maxCenters || best < 0) break;
+
+		// New column of the regularized system, rows past numExample + k are zero in every column
+		int k = centers.size();
+		int len = numExample + k + 1;
+		for (int i = 0; i < numExample; i++) newColumn[i] = candMat(i, best);
+		std::fill(newColumn.begin() + numExample, newColumn.begin() + len, 0.0);
+		newColumn[numExample + k] = sqrtLamda;
+
+		double norm = .0f;
+		for (int i = 0; i < len; i++) norm += newColumn[i] * newColumn[i];
+		norm = sqrt(norm);
+
+		// Orthogonalize against the previous columns of Q (twice, to keep Q orthonormal)
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int m = 0; m < k; m++)
+			{
+				const double *q = &qMat(m, 0);
+				double dot = .0f;
+				for (int i = 0; i < len; i++) dot += q[i] * newColumn[i];
+				for (int i = 0; i < len; i++) newColumn[i] -= dot * q[i];
+				rMat(m, k) += dot;
+			}
+		}
+
+		double diag = .0f;
+		for (int i = 0; i < len; i++) diag += newColumn[i] * newColumn[i];
+		diag = sqrt(diag);
+		if (diag <= 1e-12 * norm)
+		{
+			// The new center is (numerically) redundant, keep the previous fit
+			for (int m = 0; m < k; m++) rMat(m, k) = .0f;
+			break;
+		}
+		centers.push_back(best);
+		used[best] = true;
+		rMat(k, k) = diag;
+		double *q = &qMat(k, 0);
+		for (int i = 0; i < len; i++) q[i] = newColumn[i] / diag;
+
+		// Project the residual out of the new column
+		double *coef = &coefMat(k, 0);
+		std::fill(coef, coef + _dimOutput, 0.0);
+		for (int i = 0; i < len; i++)
+		{
+			const double *r = &residual(i, 0);
+			for (int j = 0; j < _dimOutput; j++) coef[j] += q[i] * r[j];
+		}
+		for (int i = 0; i < len; i++)
+		{
+			double *r = &residual(i, 0);
+			for (int j = 0; j < _dimOutput; j++) r[j] -= q[i] * coef[j];
+		}
+	}
+
+	if (centers.size() == 0) return -1;
+
+	// Keep only the selected centers, so that Interpolate() evaluates k instead of N basis functions
+	_numInput = centers.size();
+	std::vector<double> centerBuffer(_numInput * _dimInput);
+	vector<double> centerMinDist(_numInput);
+	for (int m = 0; m < _numInput; m++)
+	{
+		std::copy(input.row(centers[m]), input.row(centers[m]) + _dimInput, centerBuffer.begin() + m * _dimInput);
+		centerMinDist(m) = _minDist(centers[m]);
+	}
+	_minDist = centerMinDist;
+	buildSparseCenters(rbfMatrixView(&centerBuffer[0], _numInput, _dimInput));
+
+	// R W = Q^T [Y ; 0] by back substitution
+	_weightMat.resize(_numInput, _dimOutput, false);
+	for (int m = _numInput - 1; m >= 0; m--)
+	{
+		for (int j = 0; j < _dimOutput; j++)
+		{
+			double sum = coefMat(m, j);
+			for (int c = m + 1; c < _numInput; c++) sum -= rMat(m, c) * _weightMat(c, j);
+			_weightMat(m, j) = sum / rMat(m, m);
+		}
+	}
+
+	_basisMat.resize(numExample, _numInput, false);
+	for (int i = 0; i < numExample; i++)
+	{
+		for (int m = 0; m < _numInput; m++) _basisMat(i, m) = candMat(i, centers[m]);
+	}
+	_inverseBasisMat.resize(0, 0);
+
+	return 0;
+}
+
+int rbf::TrainGreedy(const vector<vector<double>> &input, const vector<vector<double>> &output, int maxCenters, double tolerance)
+{
+	std::vector<double> inputBuffer, outputBuffer;
+	return TrainGreedy(packRows(input, inputBuffer), packRows(output, outputBuffer), maxCenters, tolerance);
+}
+
+
+// This function prunes the trained weights : in each output column, the weights smaller than
+// threshold times the largest one of the column are set to zero, and the remaining weights of
+// the column are fitted again (least squares) to the outputs of the dense network at the centers.
+// The result is also stored in block sparse rows, which Interpolate() on raw buffers uses then.
+// _weightDensity returns the ratio of nonzero weights, _pruneError the max absolute change of
+// the outputs at the centers.
+int rbf::Prune(double threshold)
+{
+	const int n = _numInput;
+	const int dimOut = _dimOutput;
+	if (n <= 0 || dimOut <= 0 || (int)_weightMat.size1() != n) return -1;
+
+	// Basis values of the centers (without lamda) and their Gram matrix G = A^T A.
+	// The right hand side of a column, A^T A w, is then (G w) restricted to the kept weights.
+	matrix<double> basisMat(n, n);
+	for (int i = 0; i < n; i++)
+	{
+		const double *ci = &_centerFlat[i * _centerStride];
+		for (int j = 0; j < n; j++)
+		{
+			const double *cj = &_centerFlat[j * _centerStride];
+			double d2 = .0f;
+			for (int k = 0; k < _dimInput; k++)
+			{
+				double d1 = ci[k] - cj[k];
+				d2 += d1 * d1;
+			}
+			basisMat(i, j) = basisFunc(j, d2);
+		}
+	}
+	matrix<double> gramMat = prod(trans(basisMat), basisMat);
+	matrix<double> denseOut = prod(basisMat, _weightMat);
+	matrix<double> rhsMat = prod(gramMat, _weightMat);
+
+	int nnz = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:nnz) if ((long long)dimOut * n * n > RBF_PARALLEL_MIN)
+	for (int k = 0; k < dimOut; k++)
+	{
+		double wmax = .0f;
+		for (int j = 0; j < n; j++)
+		{
+			if (fabs(_weightMat(j, k)) > wmax) wmax = fabs(_weightMat(j, k));
+		}
+
+		std::vector<int> kept;
+		for (int j = 0; j < n; j++)
+		{
+			if (fabs(_weightMat(j, k)) >= threshold * wmax && _weightMat(j, k) != .0f) kept.push_back(j);
+			else _weightMat(j, k) = .0f;
+		}
+		const int numKept = kept.size();
+		nnz += numKept;
+		if (numKept == 0 || numKept == n) continue;
+
+		// Refit the kept weights : (A_S^T A_S) w_S = (G w)_S
+		matrix<double> subGram(numKept, numKept);
+		matrix<double> subRhs(numKept, 1);
+		for (int a = 0; a < numKept; a++)
+		{
+			for (int b = 0; b < numKept; b++) subGram(a, b) = gramMat(kept[a], kept[b]);
+			subRhs(a, 0) = rhsMat(kept[a], k);
+		}
+		std::vector<std::size_t> pivot;
+		if (BlockedLUFactorize(subGram, pivot) != 0) continue;		// keep the thresholded weights
+		BlockedLUSubstitute(subGram, pivot, subRhs);
+		for (int a = 0; a < numKept; a++) _weightMat(kept[a], k) = subRhs(a, 0);
+	}
+
+	matrix<double> prunedOut = prod(basisMat, _weightMat);
+	_pruneError = .0f;
+	for (int i = 0; i < n; i++)
+	{
+		for (int k = 0; k < dimOut; k++)
+		{
+			if (fabs(prunedOut(i, k) - denseOut(i, k)) > _pruneError) _pruneError = fabs(prunedOut(i, k) - denseOut(i, k));
+		}
+	}
+	_weightDensity = (double)nnz / ((double)n * dimOut);
+
+	buildSparseWeights();
+	return 0;
+}
+
+// Layout of a saved network : the sizes, then lamda, the minimum distances, the centers and the
+// weights (doubles, row major). Pruned networks keep their zero weights, Load() blocks them again.
+struct rbfSavedHeader
+{
+	int		basisFunc;
+	int		numInput;
+	int		dimInput;
+	int		dimOutput;
+	int		pruned;
+	int		reserved;
+	double	lamda;
+};
+
+// This function writes the trained network to bytes, for Load()
+// (the inverse basis matrix is not saved, so SolveWeights() is not available after Load())
+int rbf::Save(std::vector<char> &bytes) const
+{
+	if (_numInput <= 0 || (int)_weightMat.size1() != _numInput) return -1;
+
+	rbfSavedHeader header = { (int)_basisFunc, _numInput, _dimInput, _dimOutput, _prunedWeight ? 1 : 0, 0, _lamda };
+	const size_t numValue = (size_t)_numInput * (1 + _dimInput + _dimOutput);
+	bytes.resize(sizeof(header) + numValue * sizeof(double));
+	memcpy(&bytes[0], &header, sizeof(header));
+
+	double *v = (double*)&bytes[sizeof(header)];
+	for (int i = 0; i < _numInput; i++) *v++ = _minDist(i);
+	for (int i = 0; i < _numInput; i++, v += _dimInput)
+	{
+		std::copy(&_centerFlat[i * _centerStride], &_centerFlat[i * _centerStride] + _dimInput, v);
+	}
+	std::copy(&_weightMat.data()[0], &_weightMat.data()[0] + (size_t)_numInput * _dimOutput, v);
+	return 0;
+}
+
+// This function reads a network written by Save()
+int rbf::Load(const char *bytes, size_t size)
+{
+	rbfSavedHeader header;
+	if (size < sizeof(header)) return -1;
+	memcpy(&header, bytes, sizeof(header));
+	if (header.basisFunc != BF_HARDY || header.numInput <= 0 || header.dimInput <= 0 || header.dimOutput <= 0) return -1;
+
+	// The sizes are checked by division, so that no product of header values can overflow
+	const size_t maxValue = (size - sizeof(header)) / sizeof(double);
+	const unsigned long long perInput = 1ULL + (unsigned long long)header.dimInput + (unsigned long long)header.dimOutput;
+	if ((size - sizeof(header)) % sizeof(double) != 0 || perInput > maxValue || (unsigned long long)header.numInput > maxValue / perInput) return -1;
+	const size_t numValue = (size_t)header.numInput * (size_t)perInput;
+	if (numValue != maxValue) return -1;
+
+	reset();
+	_basisFunc = (BFType)header.basisFunc;
+	_lamda = header.lamda;
+	_numInput = header.numInput;
+	_dimInput = header.dimInput;
+	_dimOutput = header.dimOutput;
+
+	// The values may not be aligned in bytes
+	std::vector<double> values(numValue);
+	memcpy(&values[0], bytes + sizeof(header), numValue * sizeof(double));
+	const double *v = &values[0];
+
+	_minDist.resize(_numInput);
+	for (int i = 0; i < _numInput; i++) _minDist(i) = *v++;
+	buildSparseCenters(rbfMatrixView(v, _numInput, _dimInput));
+	v += (size_t)_numInput * _dimInput;
+	_weightMat.resize(_numInput, _dimOutput, false);
+	std::copy(v, v + (size_t)_numInput * _dimOutput, &_weightMat.data()[0]);
+
+	if (header.pruned)
+	{
+		int nnz = 0;
+		for (size_t k = 0; k < (size_t)_numInput * _dimOutput; k++) if (v[k] != .0f) nnz++;
+		_weightDensity = (double)nnz / ((double)_numInput * _dimOutput);
+		buildSparseWeights();
+	}
+	return 0;
+}
+
+// This function stores the nonzero weights of _weightMat in blocks of RBF_WEIGHT_BLOCK consecutive
+// outputs of one center. Blocks are grouped by chunk of RBF_FIXED_CENTERS centers, then by output
+// block (compressed like CSR in _weightPtr), so interpolatePruned() sums an output block over a
+// chunk in registers. The last output block is moved back to end at the last output (its weights
+// already stored in the previous block are zero), so every block is full.
+// Models with less outputs than a block keep the dense weights.
+void rbf::buildSparseWeights()
+{
+	const int n = _numInput;
+	const int dimOut = _dimOutput;
+	_weightPtr.clear();
+	_weightCenter.clear();
+	_weightVal.clear();
+	_prunedWeight = false;
+	if (dimOut < RBF_WEIGHT_BLOCK) return;
+
+	const int numBlock = (dimOut + RBF_WEIGHT_BLOCK - 1) / RBF_WEIGHT_BLOCK;
+	_weightPtr.push_back(0);
+	for (int j0 = 0; j0 < n; j0 += RBF_FIXED_CENTERS)
+	{
+		const int j1 = (j0 + RBF_FIXED_CENTERS < n) ? j0 + RBF_FIXED_CENTERS : n;
+		for (int b = 0; b < numBlock; b++)
+		{
+			const int first = b * RBF_WEIGHT_BLOCK;
+			const int k0 = (first + RBF_WEIGHT_BLOCK <= dimOut) ? first : dimOut - RBF_WEIGHT_BLOCK;
+			for (int j = j0; j < j1; j++)
+			{
+				double val[RBF_WEIGHT_BLOCK];
+				bool nonzero = false;
+				for (int t = 0; t < RBF_WEIGHT_BLOCK; t++)
+				{
+					val[t] = (k0 + t >= first) ? _weightMat(j, k0 + t) : .0f;
+					if (val[t] != .0f) nonzero = true;
+				}
+				if (!nonzero) continue;
+				_weightCenter.push_back(j);
+				_weightVal.insert(_weightVal.end(), val, val + RBF_WEIGHT_BLOCK);
+			}
+			_weightPtr.push_back(_weightCenter.size());
+		}
+	}
+	_prunedWeight = true;
+}
 
 
 
@@ -141,12 +707,20 @@ int rbf::Interpolate(const vector<double> &sample, vector<double> &result) // In
 {
 	int j;
 
+	// Pruned weights : sparse-dense product on the raw buffers
+	if (_prunedWeight)
+	{
+		result.resize(_dimOutput, false);
+		return Interpolate(&sample.data()[0], &result.data()[0]);
+	}
+
 	matrix<double> sampleMat(1, _numInput);
 	matrix<double> resultMat(1, _dimOutput);
 
+	double norm = sampleNorm(&sample.data()[0]);
 	for (j = 0; j<_numInput; j++)
 	{
-		sampleMat(0, j) = basisFunc(j, dist(sample, _input(j)));
+		sampleMat(0, j) = basisFunc(j, centerDist(&sample.data()[0], norm, j));
 	}
 	resultMat = prod(sampleMat, _weightMat);
 
@@ -165,14 +739,29 @@ int rbf::Interpolate(const vector<vector<double>> &sample, vector<vector<double>
 	int numSample = sample.size();
 	vector<double> temp(_dimOutput);
 
+	// Pruned weights : sparse-dense product on the raw buffers, sample by sample
+	if (_prunedWeight)
+	{
+		result.resize(numSample);
+#pragma omp parallel for schedule(dynamic, 256) if ((long long)numSample * _numInput * _dimOutput > RBF_PARALLEL_MIN)
+		for (i = 0; i < numSample; i++)
+		{
+			result(i).resize(_dimOutput, false);
+			Interpolate(&sample(i).data()[0], &result(i).data()[0]);
+		}
+		return 0;
+	}
+
 	matrix<double> sampleMat(numSample, _numInput);
 	matrix<double> resultMat(numSample, _dimOutput);
 
 	for (i = 0; i<numSample; i++)
 	{
+		const double *s = &sample(i).data()[0];
+		double norm = sampleNorm(s);
 		for (j = 0; j<_numInput; j++)
 		{
-			sampleMat(i, j) = basisFunc(j, dist(sample(i), _input(j)));
+			sampleMat(i, j) = basisFunc(j, centerDist(s, norm, j));
 		}
 	}
 
@@ -198,4 +787,346 @@ int rbf::Interpolate(const matrix<double> &sample, matrix<double> &result)	// In
 
 	result = prod(sample, _weightMat);
 	return 0;
-}
\ No newline at end of file
+}
+
+// Partial sums of BLOCK samples for the WIDTH outputs at result (row stride DIM_OUT) :
+// result += phi * w over numCenter centers. The sums stay in registers over all centers.
+template<int BLOCK, int WIDTH, int DIM_OUT>
+static inline void accumulateTile(const double *phi, int numCenter, const double *w, double *result)
+{
+	double acc[BLOCK][WIDTH];
+	for (int i = 0; i < BLOCK; i++)
+		for (int t = 0; t < WIDTH; t++) acc[i][t] = result[i * DIM_OUT + t];
+
+	for (int j = 0; j < numCenter; j++)
+	{
+		const double *wj = w + j * DIM_OUT;
+		for (int i = 0; i < BLOCK; i++)
+		{
+			const double p = phi[j * BLOCK + i];
+			for (int t = 0; t < WIDTH; t++) acc[i][t] += p * wj[t];
+		}
+	}
+
+	for (int i = 0; i < BLOCK; i++)
+		for (int t = 0; t < WIDTH; t++) result[i * DIM_OUT + t] = acc[i][t];
+}
+
+// Interpolate kernel with the dimensions known at compile time, for BLOCK samples at once.
+// The basis values of a chunk of centers are computed first, then the outputs are accumulated
+// tile by tile (RBF_FIXED_TILE outputs x BLOCK samples in registers), so each weight is loaded
+// once per block instead of once per sample and no partial sum goes through memory.
+// Same operations in the same order per sample as the generic path of Interpolate().
+template<int DIM_IN, int DIM_OUT, int BLOCK>
+void rbf::interpolateFixed(const double *sample, double *result) const
+{
+	const int numCenter = _numInput;
+	const int stride = (DIM_IN + RBF_CENTER_ALIGN - 1) / RBF_CENTER_ALIGN * RBF_CENTER_ALIGN;
+	const double *w = &_weightMat.data()[0];
+	double phi[RBF_FIXED_CENTERS * BLOCK];
+
+	for (int i = 0; i < BLOCK * DIM_OUT; i++) result[i] = .0f;
+
+	for (int j0 = 0; j0 < numCenter; j0 += RBF_FIXED_CENTERS)
+	{
+		const int numChunk = (j0 + RBF_FIXED_CENTERS < numCenter) ? RBF_FIXED_CENTERS : numCenter - j0;
+
+		for (int j = 0; j < numChunk; j++)
+		{
+			const double *c = &_centerFlat[(j0 + j) * stride];
+			for (int i = 0; i < BLOCK; i++)
+			{
+				const double *s = sample + i * DIM_IN;
+				double d2 = .0f;
+				for (int k = 0; k < DIM_IN; k++)
+				{
+					double d1 = s[k] - c[k];
+					d2 += d1 * d1;
+				}
+				phi[j * BLOCK + i] = basisFunc(j0 + j, d2);
+			}
+		}
+
+		const double *wChunk = w + j0 * DIM_OUT;
+		const int numTile = DIM_OUT / RBF_FIXED_TILE;
+		for (int t = 0; t < numTile; t++)
+			accumulateTile<BLOCK, RBF_FIXED_TILE, DIM_OUT>(phi, numChunk, wChunk + t * RBF_FIXED_TILE, result + t * RBF_FIXED_TILE);
+		if (DIM_OUT % RBF_FIXED_TILE)
+			accumulateTile<BLOCK, (DIM_OUT % RBF_FIXED_TILE) ? (DIM_OUT % RBF_FIXED_TILE) : 1, DIM_OUT>(
+				phi, numChunk, wChunk + numTile * RBF_FIXED_TILE, result + numTile * RBF_FIXED_TILE);
+	}
+}
+
+// Dimensions (input, output) compiled into the fixed dimension kernels : the standard rig sizes.
+// Both interpolateFixedDims() and hasFixedDims() are generated from this list.
+#define RBF_FIXED_DIMS_LIST(X)															\
+	X(35, 201)		/* koko (FRRTraining) */											\
+	X(3, 3)			/* frrWarpDeformer */
+
+// This function runs the kernel compiled for the dimensions of the model on numSample samples
+// (blocks of RBF_FIXED_BLOCK, then one by one), returns false for other dimensions (the generic
+// loop is used then).
+bool rbf::interpolateFixedDims(const double *sample, int numSample, double *result) const
+{
+#define RBF_FIXED_DIMS(IN, OUT)																\
+	if (_dimInput == IN && _dimOutput == OUT)												\
+	{																						\
+		int i = 0;																			\
+		for (; i + RBF_FIXED_BLOCK <= numSample; i += RBF_FIXED_BLOCK)						\
+			interpolateFixed<IN, OUT, RBF_FIXED_BLOCK>(sample + i * IN, result + i * OUT);	\
+		for (; i < numSample; i++)															\
+			interpolateFixed<IN, OUT, 1>(sample + i * IN, result + i * OUT);				\
+		return true;																		\
+	}
+
+	RBF_FIXED_DIMS_LIST(RBF_FIXED_DIMS)
+#undef RBF_FIXED_DIMS
+
+	return false;
+}
+
+// This function tells if the model has one of the sizes of interpolateFixedDims()
+bool rbf::hasFixedDims() const
+{
+#define RBF_FIXED_DIMS(IN, OUT)		if (_dimInput == IN && _dimOutput == OUT) return true;
+	RBF_FIXED_DIMS_LIST(RBF_FIXED_DIMS)
+#undef RBF_FIXED_DIMS
+
+	return false;
+}
+
+// Interpolate kernel of the pruned weights (see buildSparseWeights) : sparse-dense product of
+// the basis values of a chunk of centers and the stored blocks, the cost is proportional to
+// the number of nonzero blocks.
+void rbf::interpolatePruned(const double *sample, double *result) const
+{
+	const int numCenter = _numInput;
+	const int dimIn = _dimInput;
+	const int dimOut = _dimOutput;
+	const int numBlock = (dimOut + RBF_WEIGHT_BLOCK - 1) / RBF_WEIGHT_BLOCK;
+	const int *ptr = &_weightPtr[0];
+	double phi[RBF_FIXED_CENTERS];
+
+	for (int k = 0; k < dimOut; k++) result[k] = .0f;
+
+	for (int j0 = 0; j0 < numCenter; j0 += RBF_FIXED_CENTERS)
+	{
+		const int numChunk = (j0 + RBF_FIXED_CENTERS < numCenter) ? RBF_FIXED_CENTERS : numCenter - j0;
+		for (int j = 0; j < numChunk; j++)
+		{
+			const double *c = &_centerFlat[(j0 + j) * _centerStride];
+			double d2 = .0f;
+			for (int k = 0; k < dimIn; k++)
+			{
+				double d1 = sample[k] - c[k];
+				d2 += d1 * d1;
+			}
+			phi[j] = basisFunc(j0 + j, d2);
+		}
+
+		for (int b = 0; b < numBlock; b++, ptr++)
+		{
+			if (ptr[0] == ptr[1]) continue;
+			double acc[RBF_WEIGHT_BLOCK] = { .0f };
+			for (int e = ptr[0]; e < ptr[1]; e++)
+			{
+				const double p = phi[_weightCenter[e] - j0];
+				const double *v = &_weightVal[e * RBF_WEIGHT_BLOCK];
+				for (int t = 0; t < RBF_WEIGHT_BLOCK; t++) acc[t] += p * v[t];
+			}
+
+			// The last block overlaps the previous one, its first weights are zero
+			const int first = b * RBF_WEIGHT_BLOCK;
+			const int k0 = (first + RBF_WEIGHT_BLOCK <= dimOut) ? first : dimOut - RBF_WEIGHT_BLOCK;
+			for (int t = first - k0; t < RBF_WEIGHT_BLOCK; t++) result[k0 + t] += acc[t];
+		}
+	}
+}
+
+// Single sample interpolate function on raw buffers (sample : _dimInput, result : _dimOutput).
+// Nothing is allocated and the model is only read, so it can be called from several threads
+// at once (e.g. DG nodes evaluated in parallel).
+int rbf::Interpolate(const double *sample, double *result) const
+{
+	if (_numInput <= 0 || _dimOutput <= 0) return -1;
+	if (_prunedWeight) { interpolatePruned(sample, result); return 0; }
+	if (interpolateFixedDims(sample, 1, result)) return 0;
+
+	const int numCenter = _numInput;
+	const int dimIn = _dimInput;
+	const int dimOut = _dimOutput;
+	const double *w = &_weightMat.data()[0];
+
+	for (int k = 0; k < dimOut; k++) result[k] = .0f;
+
+	for (int j = 0; j < numCenter; j++)
+	{
+		const double *c = &_centerFlat[j * _centerStride];
+		double d2 = .0f;
+		for (int k = 0; k < dimIn; k++)
+		{
+			double d1 = sample[k] - c[k];
+			d2 += d1 * d1;
+		}
+		const double phi = basisFunc(j, d2);
+		const double *wj = w + j * dimOut;
+		for (int k = 0; k < dimOut; k++) result[k] += phi * wj[k];
+	}
+
+	return 0;
+}
+
+// Batched interpolate function on raw row-major buffers
+// (sample : numSample x _dimInput, result : numSample x _dimOutput).
+// Samples are evaluated independently on all cores, without any allocation per sample.
+int rbf::InterpolateBatch(const double *sample, int numSample, double *result)
+{
+	if (_numInput <= 0 || _dimOutput <= 0) return -1;
+
+	// Blocks of samples for the standard rig sizes
+	if (hasFixedDims() && !_prunedWeight)
+	{
+		const int numBlock = (numSample + RBF_FIXED_BLOCK - 1) / RBF_FIXED_BLOCK;
+#pragma omp parallel for schedule(dynamic, 64) if ((long long)numSample * _numInput * _dimOutput > RBF_PARALLEL_MIN)
+		for (int b = 0; b < numBlock; b++)
+		{
+			const int i = b * RBF_FIXED_BLOCK;
+			const int n = (i + RBF_FIXED_BLOCK < numSample) ? RBF_FIXED_BLOCK : numSample - i;
+			interpolateFixedDims(sample + i * _dimInput, n, result + i * _dimOutput);
+		}
+		return 0;
+	}
+
+#pragma omp parallel for schedule(dynamic, 256) if ((long long)numSample * _numInput * _dimOutput > RBF_PARALLEL_MIN)
+	for (int i = 0; i < numSample; i++)
+	{
+		Interpolate(sample + i * _dimInput, result + i * _dimOutput);
+	}
+
+	return 0;
+}
+
+
+// Cubic Hermite reconstruction of frame t between the keys a and b of frames(evaluated frames,
+// dim values per frame). Tangents are Catmull-Rom ones from the neighbouring keys pa (before a)
+// and pb (after b), pa == a or pb == b at the ends of the sequence.
+static void hermiteFrame(const double *frames, int dim, int pa, int a, int b, int pb, int t, double *out)
+{
+	double len = b - a;
+	double s = (t - a) / len;
+	double s2 = s * s, s3 = s2 * s;
+	double h00 = 2 * s3 - 3 * s2 + 1, h10 = s3 - 2 * s2 + s;
+	double h01 = -2 * s3 + 3 * s2, h11 = s3 - s2;
+
+	const double *ka = frames + a * dim, *kb = frames + b * dim, *kpa = frames + pa * dim, *kpb = frames + pb * dim;
+	for (int k = 0; k < dim; k++)
+	{
+		double ma = (kb[k] - kpa[k]) / (b - pa);
+		double mb = (kpb[k] - ka[k]) / (pb - a);
+		out[k] = h00 * ka[k] + h10 * len * ma + h01 * kb[k] + h11 * len * mb;
+	}
+}
+
+// Adaptive interpolate function for a smooth input sequence (one sample per frame) on raw
+// row-major buffers (sample : numSample x _dimInput, result : numSample x _dimOutput)
+//   - evaluate the RBF every RBF_ADAPTIVE_STEP frames
+//   - evaluate the midpoint of each interval, and split the interval again if its
+//     Hermite prediction misses by more than tolerance (max absolute error)
+//   - reconstruct the frames which were not evaluated with cubic Hermite curves
+// numEvaluated returns the number of frames the RBF was actually evaluated on.
+int rbf::InterpolateAdaptive(const double *sample, int numSample, double *result, double tolerance, int &numEvaluated)
+{
+	numEvaluated = 0;
+	if (numSample == 0) return 0;
+	if (_numInput <= 0 || _dimOutput <= 0) return -1;
+
+	const int dimIn = _dimInput;
+	const int dimOut = _dimOutput;
+	std::vector<bool> evaluated(numSample, false);
+	std::vector<std::pair<int, int>> intervals;
+
+	// Initial keys
+	for (int i = 0; i < numSample; i += RBF_ADAPTIVE_STEP)
+	{
+		Interpolate(sample + i * dimIn, result + i * dimOut);
+		evaluated[i] = true;
+		numEvaluated++;
+		if (i > 0) intervals.push_back(std::make_pair(i - RBF_ADAPTIVE_STEP, i));
+	}
+	int lastKey = ((numSample - 1) / RBF_ADAPTIVE_STEP) * RBF_ADAPTIVE_STEP;
+	if (!evaluated[numSample - 1])
+	{
+		Interpolate(sample + (numSample - 1) * dimIn, result + (numSample - 1) * dimOut);
+		evaluated[numSample - 1] = true;
+		numEvaluated++;
+		intervals.push_back(std::make_pair(lastKey, numSample - 1));
+	}
+
+	// Refine the intervals whose midpoint is not predicted well enough
+	std::vector<double> predicted(dimOut);
+	while (!intervals.empty())
+	{
+		int a = intervals.back().first;
+		int b = intervals.back().second;
+		intervals.pop_back();
+		if (b - a < 2) continue;
+
+		int pa = a, pb = b;
+		for (int i = a - 1; i >= 0; i--) { if (evaluated[i]) { pa = i; break; } }
+		for (int i = b + 1; i < numSample; i++) { if (evaluated[i]) { pb = i; break; } }
+
+		int m = (a + b) / 2;
+		hermiteFrame(result, dimOut, pa, a, b, pb, m, &predicted[0]);
+		double *rm = result + m * dimOut;
+		Interpolate(sample + m * dimIn, rm);
+		evaluated[m] = true;
+		numEvaluated++;
+
+		double err = .0f;
+		for (int k = 0; k < dimOut; k++)
+		{
+			if (fabs(predicted[k] - rm[k]) > err) err = fabs(predicted[k] - rm[k]);
+		}
+		if (err > tolerance)
+		{
+			intervals.push_back(std::make_pair(m, b));
+			intervals.push_back(std::make_pair(a, m));
+		}
+	}
+
+	// Reconstruct the remaining frames from the final keys
+	int pa = 0, a = 0;
+	for (int t = 1; t < numSample; t++)
+	{
+		if (evaluated[t]) { pa = a; a = t; continue; }
+
+		int b = t + 1;
+		while (!evaluated[b]) b++;
+		int pb = b;
+		for (int i = b + 1; i < numSample; i++) { if (evaluated[i]) { pb = i; break; } }
+		for (; t < b; t++) hermiteFrame(result, dimOut, pa, a, b, pb, t, result + t * dimOut);
+		pa = a;
+		a = b;
+	}
+
+	return 0;
+}
+
+int rbf::InterpolateAdaptive(const vector<vector<double>> &sample, vector<vector<double>> &result, double tolerance, int &numEvaluated)
+{
+	int numSample = sample.size();
+	std::vector<double> sampleBuffer;
+	packRows(sample, sampleBuffer);
+	std::vector<double> resultBuffer(numSample * _dimOutput);
+	result.resize(numSample);
+	numEvaluated = 0;
+	if (numSample == 0) return 0;
+	if (InterpolateAdaptive(&sampleBuffer[0], numSample, &resultBuffer[0], tolerance, numEvaluated) != 0) return -1;
+
+	for (int i = 0; i < numSample; i++)
+	{
+		result(i).resize(_dimOutput, false);
+		std::copy(resultBuffer.begin() + i * _dimOutput, resultBuffer.begin() + (i + 1) * _dimOutput, result(i).begin());
+	}
+	return 0;
+}
@@ -4,8 +4,30 @@
 #include <boost/numeric/ublas/vector.hpp>	
 #include <boost/numeric/ublas/io.hpp>		
 #include "inverseMatrix.h"					
+#include <vector>
 using namespace boost::numeric::ublas;
 
+#define RBF_SPARSE_DENSITY	0.25	// inputs with at most this ratio of nonzeros are stored sparse
+#define RBF_ADAPTIVE_STEP	16		// initial key spacing (in frames) of InterpolateAdaptive
+#define RBF_CENTER_ALIGN	4		// rows of _centerFlat are padded to a multiple of this many doubles
+#define RBF_FIXED_BLOCK		4		// samples evaluated together by the fixed dimension kernels
+#define RBF_FIXED_TILE		4		// outputs accumulated together by the fixed dimension kernels
+#define RBF_FIXED_CENTERS	64		// centers per chunk of basis values in the fixed dimension kernels
+#define RBF_WEIGHT_BLOCK	4		// consecutive outputs stored together in the pruned weights
+#define RBF_PARALLEL_MIN	(1 << 20)	// loops with less work (multiply-adds) than this run on one thread
+
+// Non-owning view of rows x cols doubles stored row by row (e.g. a parsed data file),
+// so the training data is passed to rbf without copying it into vectors of vectors
+struct rbfMatrixView
+{
+	const double*	data;
+	int				rows;
+	int				cols;
+
+	rbfMatrixView(const double *d = 0, int r = 0, int c = 0) : data(d), rows(r), cols(c) {}
+	const double*	row(int i) const	{ return data + (size_t)i * cols; }
+};
+
 class rbf
 {
 public:
@@ -21,25 +43,53 @@ public:
 	int		_dimInput;	
 	int		_dimOutput;	
 
-	vector<vector<double>> _input;  
-
 	matrix<double>	_basisMat;			
 	matrix<double>	_inverseBasisMat;	
 	matrix<double>	_weightMat;			
 
 	vector<double>	_minDist;			
+	bool	_lowMemory;				// train without distMat and the inverse (see buildBasisMatInPlace)
+	double	_fitError;			// max absolute residual over the training examples (TrainGreedy)
+
+	bool				_sparseInput;	// centers are stored in compressed sparse rows
+	std::vector<int>	_centerPtr;		// row start of each center in _centerIdx/_centerVal
+	std::vector<int>	_centerIdx;		// dimension index of each nonzero
+	std::vector<double>	_centerVal;		// value of each nonzero
+	vector<double>		_centerNorm;	// squared norm of each center
+	std::vector<double>	_centerFlat;	// dense centers, one row of _centerStride doubles per center
+	int					_centerStride;
+
+	bool				_prunedWeight;	// weights are pruned and stored in sparse blocks (Prune)
+	std::vector<int>	_weightPtr;		// first block of each (center chunk, output block) pair
+	std::vector<int>	_weightCenter;	// center of each block
+	std::vector<double>	_weightVal;		// RBF_WEIGHT_BLOCK weights of each block
+	double				_weightDensity;	// ratio of nonzero weights after Prune
+	double				_pruneError;	// max absolute change of the outputs at the centers by Prune
 
 	
-	int		buildDistMatrix(matrix<double> &distMat, const vector<vector<double>> &input);	
-	double	basisFunc(int i, double x2);														
-	inline	double dist(const vector<double> &a, const vector<double> &b);	
-	int		buildBasisMat(const vector<vector<double>> &input);
+	int		buildDistMatrix(matrix<double> &distMat, const rbfMatrixView &input);	
+	double	basisFunc(int i, double x2) const;														
+	inline	double dist(const double *a, const double *b) const;	
+	void	buildSparseCenters(const rbfMatrixView &input);
+	void	buildFlatCenters(const rbfMatrixView &input);
+	template<int DIM_IN, int DIM_OUT, int BLOCK>
+	void	interpolateFixed(const double *sample, double *result) const;
+	bool	interpolateFixedDims(const double *sample, int numSample, double *result) const;
+	bool	hasFixedDims() const;
+	void	buildSparseWeights();
+	void	interpolatePruned(const double *sample, double *result) const;
+	inline	double centerDist(const double *a, double normA, int j) const;
+	inline	double sampleNorm(const double *a) const;
+	int		buildBasisMat(const rbfMatrixView &input);
+	int		buildBasisMatInPlace(const rbfMatrixView &input);
 
 public:
 
 	rbf():																					// constructor
 	  _basisFunc(BF_HARDY), _lamda(.0f), _numInput(0), _dimInput(0), _dimOutput(0),			// initialize
-		  _basisMat(0, 0), _weightMat(0, 0), _minDist(0), _inverseBasisMat(0, 0)			// (0, 0) represents (row, column)
+		  _basisMat(0, 0), _weightMat(0, 0), _minDist(0), _inverseBasisMat(0, 0), _lowMemory(false), _fitError(.0f),
+		  _sparseInput(false), _centerNorm(0), _centerStride(0),
+		  _prunedWeight(false), _weightDensity(1.0), _pruneError(.0f)							// (0, 0) represents (row, column)
 	  {
 	  }
 
@@ -59,6 +109,20 @@ public:
 		  _weightMat.resize(0, 0);
 		  _minDist.resize(0);
 		  _inverseBasisMat.resize(0, 0);
+		  _fitError = .0f;
+		  _sparseInput = false;
+		  _centerPtr.clear();
+		  _centerIdx.clear();
+		  _centerVal.clear();
+		  _centerNorm.resize(0);
+		  _centerFlat.clear();
+		  _centerStride = 0;
+		  _prunedWeight = false;
+		  _weightPtr.clear();
+		  _weightCenter.clear();
+		  _weightVal.clear();
+		  _weightDensity = 1.0;
+		  _pruneError = .0f;
 	  }
 
 	  
@@ -66,10 +130,30 @@ public:
 	  BFType getBasisFunc()			{ return _basisFunc; }		
 	  void setLamda(double value)		{ _lamda = value; }			
 	  double getLamda()				{ return _lamda; }		
+	  void setLowMemory(bool value)	{ _lowMemory = value; }
+	  bool getLowMemory()			{ return _lowMemory; }
+	  int getNumCenters()			{ return _numInput; }
+	  int getDimInput()				{ return _dimInput; }
+	  int getDimOutput()			{ return _dimOutput; }
+	  double getFitError()			{ return _fitError; }
+	  double getWeightDensity()		{ return _weightDensity; }
+	  double getPruneError()		{ return _pruneError; }
 	  
+	  int Train(const rbfMatrixView &input, const rbfMatrixView &output);
 	  int Train(const vector<vector<double>> &input, const vector<vector<double>> &output);
+	  int SolveWeights(const rbfMatrixView &output);
+	  int SolveWeights(const vector<vector<double>> &output);
+	  int TrainGreedy(const rbfMatrixView &input, const rbfMatrixView &output, int maxCenters, double tolerance);
+	  int TrainGreedy(const vector<vector<double>> &input, const vector<vector<double>> &output, int maxCenters, double tolerance);
+	  int Prune(double threshold);
+	  int Save(std::vector<char> &bytes) const;
+	  int Load(const char *bytes, size_t size);
 	 
 	  int Interpolate(const vector<double> &sample, vector<double> &result);
 	  int Interpolate(const vector<vector<double>> &sample, vector<vector<double>> &result);
 	  int Interpolate(const matrix<double> &sample, matrix<double> &result);
+	  int Interpolate(const double *sample, double *result) const;
+	  int InterpolateBatch(const double *sample, int numSample, double *result);
+	  int InterpolateAdaptive(const double *sample, int numSample, double *result, double tolerance, int &numEvaluated);
+	  int InterpolateAdaptive(const vector<vector<double>> &sample, vector<vector<double>> &result, double tolerance, int &numEvaluated);
 };
\ No newline at end of file